@@ -0,0 +1,128 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Helpers shared by the benchmarks. Benchmarks print one CSV line per
+ * measured point (after a header line), so results can be loaded directly.
+ */
+
+#define BENCH_MAX_THREADS 256
+
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Run 'threads' threads executing fn, each gets its index in args[i].index
+ */
+struct bench_thread {
+    unsigned index;
+    void* arg;
+};
+typedef struct bench_thread bench_thread_t;
+
+static inline void bench_run_threads(unsigned threads, void* (*fn)(void*), void* arg) {
+    pthread_t handlers[BENCH_MAX_THREADS];
+    bench_thread_t args[BENCH_MAX_THREADS];
+    for (unsigned i = 0; i < threads; i++) {
+        args[i].index = i;
+        args[i].arg = arg;
+        if (pthread_create(&handlers[i], NULL, fn, &args[i]) != 0) {
+            fprintf(stderr, "Could not create thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (unsigned i = 0; i < threads; i++)
+        pthread_join(handlers[i], NULL);
+}
+
+/*
+ * Thread counts of a sweep: powers of two, and max_threads at the end.
+ * Returns 0 once the sweep is done.
+ */
+static inline unsigned bench_next_threads(unsigned threads, unsigned max_threads) {
+    if (threads >= max_threads)
+        return 0;
+    return threads * 2 > max_threads ? max_threads : threads * 2;
+}
+
+/*
+ * Parse common arguments: maximal number of threads and duration of one
+ * measurement in milliseconds
+ */
+static inline void bench_parse_args(int argc, char** argv, unsigned* max_threads, unsigned* duration_ms) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    *max_threads = cpus > 0 ? (unsigned)cpus : 1;
+    *duration_ms = 500;
+    if (argc > 1)
+        *max_threads = (unsigned)atoi(argv[1]);
+    if (argc > 2)
+        *duration_ms = (unsigned)atoi(argv[2]);
+    if (*max_threads < 1 || *max_threads > BENCH_MAX_THREADS) {
+        fprintf(stderr, "Usage: %s [max threads <= %d] [duration ms]\n", argv[0], BENCH_MAX_THREADS);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * Histogram of latencies in nanoseconds. Buckets are 1/16 of a power of two
+ * wide, so percentiles are precise to about 6% in constant memory.
+ */
+#define BENCH_HIST_SUB 16
+#define BENCH_HIST_BUCKETS (61 * BENCH_HIST_SUB)
+
+struct bench_hist {
+    uint64_t counts[BENCH_HIST_BUCKETS];
+    uint64_t total;
+};
+typedef struct bench_hist bench_hist_t;
+
+static inline size_t bench_hist_bucket(uint64_t ns) {
+    if (ns < BENCH_HIST_SUB)
+        return (size_t)ns;
+    unsigned msb = 63 - (unsigned)__builtin_clzll(ns);
+    return (msb - 3) * BENCH_HIST_SUB + ((ns >> (msb - 4)) & (BENCH_HIST_SUB - 1));
+}
+
+/*
+ * Smallest latency of given bucket
+ */
+static inline uint64_t bench_hist_value(size_t bucket) {
+    if (bucket < BENCH_HIST_SUB)
+        return bucket;
+    unsigned msb = (unsigned)(bucket / BENCH_HIST_SUB) + 3;
+    return (uint64_t)(BENCH_HIST_SUB + bucket % BENCH_HIST_SUB) << (msb - 4);
+}
+
+static inline void bench_hist_add(bench_hist_t* hist, uint64_t ns) {
+    hist->counts[bench_hist_bucket(ns)]++;
+    hist->total++;
+}
+
+static inline void bench_hist_merge(bench_hist_t* into, const bench_hist_t* hist) {
+    for (size_t i = 0; i < BENCH_HIST_BUCKETS; i++)
+        into->counts[i] += hist->counts[i];
+    into->total += hist->total;
+}
+
+/*
+ * Latency below which given fraction of samples are, 0 if there are none
+ */
+static inline uint64_t bench_hist_percentile(const bench_hist_t* hist, double fraction) {
+    uint64_t rank = (uint64_t)(fraction * (double)hist->total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BENCH_HIST_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen > rank)
+            return bench_hist_value(i);
+    }
+    return 0;
+}
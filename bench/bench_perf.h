@@ -0,0 +1,59 @@
+#pragma once
+
+/* Includer must request _DEFAULT_SOURCE (for syscall) before any header */
+
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * Hardware cache miss counters of the process, counting threads created
+ * after bench_counters_open once they are joined. Counters which the system
+ * does not provide (no PMU, perf_event_paranoid) read as -1.
+ */
+
+enum {
+    BENCH_L1D_MISSES = 0,       /* L1 data cache read misses */
+    BENCH_LLC_MISSES,           /* Last level cache misses */
+    BENCH_COUNTERS
+};
+
+struct bench_counters {
+    int fds[BENCH_COUNTERS];
+};
+typedef struct bench_counters bench_counters_t;
+
+static inline int bench_counter_open(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static inline void bench_counters_open(bench_counters_t* counters) {
+    counters->fds[BENCH_L1D_MISSES] = bench_counter_open(PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    counters->fds[BENCH_LLC_MISSES] = bench_counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+}
+
+/*
+ * Read and close the counters
+ */
+static inline void bench_counters_close(bench_counters_t* counters, int64_t values[BENCH_COUNTERS]) {
+    for (int i = 0; i < BENCH_COUNTERS; i++) {
+        uint64_t value;
+        values[i] = -1;
+        if (counters->fds[i] < 0)
+            continue;
+        if (read(counters->fds[i], &value, sizeof(value)) == (ssize_t)sizeof(value))
+            values[i] = (int64_t)value;
+        close(counters->fds[i]);
+    }
+}
@@ -0,0 +1,97 @@
+/*
+ * Commit throughput of every global clock scheme as threads scale.
+ *
+ * Every thread increments its own counter (in its own cache line) in small
+ * read-write transactions, so transactions never conflict on data and the
+ * global clock is the only shared variable commits write. Any abort is thus
+ * a false one, caused by the clock scheme.
+ *
+ * Usage: clock_bench [max threads] [duration ms]
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+
+#include "bench.h"
+
+#define FIELDS_PER_THREAD 8 /* One cache line of 8-byte fields */
+
+static const char* const scheme_names[TM_CLOCK_COUNT] = {
+    "gv1", "gv4", "gv5", "gv6", "partitioned"
+};
+
+struct run {
+    shared_t tm;
+    uint64_t deadline_ns;
+    atomic_ullong commits;
+    atomic_ullong aborts;
+};
+
+static void* worker(void* arg) {
+    bench_thread_t* thread = (bench_thread_t*)arg;
+    struct run* run = (struct run*)thread->arg;
+    shared_t tm = run->tm;
+    char* counter = (char*)tm_start(tm) + thread->index * FIELDS_PER_THREAD * sizeof(uint64_t);
+    unsigned long long commits = 0, aborts = 0;
+
+    while (bench_now_ns() < run->deadline_ns) {
+        for (int i = 0; i < 64; i++) {
+            uint64_t value;
+            tx_t tx = tm_begin(tm, false);
+            if (tx == invalid_tx) {
+                aborts++;
+                continue;
+            }
+            if (!tm_read(tm, tx, counter, sizeof(value), &value)) {
+                aborts++;
+                continue;
+            }
+            value++;
+            if (!tm_write(tm, tx, &value, sizeof(value), counter) || !tm_end(tm, tx)) {
+                aborts++;
+                continue;
+            }
+            commits++;
+        }
+    }
+    run->commits += commits;
+    run->aborts += aborts;
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    unsigned max_threads, duration_ms;
+    bench_parse_args(argc, argv, &max_threads, &duration_ms);
+
+    printf("scheme,threads,commits,aborts,seconds,commits_per_sec,aborts_per_commit\n");
+    for (int scheme = 0; scheme < TM_CLOCK_COUNT; scheme++) {
+        for (unsigned threads = 1; threads; threads = bench_next_threads(threads, max_threads)) {
+            tm_config_t config;
+            tm_config_default(&config);
+            config.clock = (tm_clock_t)scheme;
+
+            struct run run;
+            run.tm = tm_create_ext(threads * FIELDS_PER_THREAD * sizeof(uint64_t), sizeof(uint64_t), &config);
+            if (run.tm == invalid_shared) {
+                fprintf(stderr, "Could not create region\n");
+                return EXIT_FAILURE;
+            }
+            run.commits = 0;
+            run.aborts = 0;
+            uint64_t start = bench_now_ns();
+            run.deadline_ns = start + (uint64_t)duration_ms * 1000000ull;
+            bench_run_threads(threads, worker, &run);
+            double seconds = (bench_now_ns() - start) / 1e9;
+            tm_destroy(run.tm);
+
+            printf("%s,%u,%llu,%llu,%.3f,%.0f,%.3f\n", scheme_names[scheme], threads,
+                (unsigned long long)run.commits, (unsigned long long)run.aborts,
+                seconds, run.commits / seconds, run.commits ? (double)run.aborts / run.commits : 0.0);
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+/*
+ * Commit throughput of every engine on the transfer scenarios of my_tests.c.
+ *
+ * Threads move 1 between two numbers chosen at random, in read-write
+ * transactions run by tm_atomic: among 2 numbers in multi_1, among 10 in
+ * multi_2. Aborts are the retries tm_atomic counted. Transfers keep the sum
+ * of the numbers at 0, which is checked after every run.
+ *
+ * Usage: engine_bench [max threads] [duration ms]
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+
+#include "bench.h"
+
+static const char* const engine_names[TM_ENGINE_COUNT] = {
+    "tl2", "norec", "etl"
+};
+
+struct scenario {
+    const char* name;
+    size_t nums;
+};
+
+static const struct scenario scenarios[] = {
+    {"multi_1", 2},
+    {"multi_2", 10},
+};
+
+struct run {
+    shared_t tm;
+    size_t nums;
+    uint64_t deadline_ns;
+};
+
+struct transfer {
+    char* start;
+    size_t num1, num2;
+};
+
+static bool transfer_body(shared_t tm, tx_t tx, void* arg) {
+    struct transfer* transfer = (struct transfer*)arg;
+    long long val1, val2;
+    char* addr1 = transfer->start + transfer->num1 * sizeof(long long);
+    char* addr2 = transfer->start + transfer->num2 * sizeof(long long);
+
+    if (!tm_read(tm, tx, addr1, sizeof(val1), &val1))
+        return false;
+    val1--;
+    if (!tm_write(tm, tx, &val1, sizeof(val1), addr1))
+        return false;
+    if (!tm_read(tm, tx, addr2, sizeof(val2), &val2))
+        return false;
+    val2++;
+    return tm_write(tm, tx, &val2, sizeof(val2), addr2);
+}
+
+struct sum {
+    char* start;
+    size_t nums;
+    long long sum;
+};
+
+static bool sum_body(shared_t tm, tx_t tx, void* arg) {
+    struct sum* sum = (struct sum*)arg;
+    sum->sum = 0;
+    for (size_t i = 0; i < sum->nums; i++) {
+        long long val;
+        if (!tm_read(tm, tx, sum->start + i * sizeof(long long), sizeof(val), &val))
+            return false;
+        sum->sum += val;
+    }
+    return true;
+}
+
+static void* worker(void* arg) {
+    bench_thread_t* thread = (bench_thread_t*)arg;
+    struct run* run = (struct run*)thread->arg;
+    unsigned seed = thread->index * 7919 + 1;
+    struct transfer transfer = {tm_start(run->tm), 0, 0};
+
+    while (bench_now_ns() < run->deadline_ns) {
+        for (int i = 0; i < 64; i++) {
+            transfer.num1 = rand_r(&seed) % run->nums;
+            transfer.num2 = rand_r(&seed) % run->nums;
+            if (!tm_atomic(run->tm, false, transfer_body, &transfer)) {
+                fprintf(stderr, "Could not begin transaction\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    unsigned max_threads, duration_ms;
+    bench_parse_args(argc, argv, &max_threads, &duration_ms);
+
+    printf("engine,scenario,threads,commits,aborts,seconds,commits_per_sec\n");
+    for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+        for (int engine = 0; engine < TM_ENGINE_COUNT; engine++) {
+            for (unsigned threads = 1; threads; threads = bench_next_threads(threads, max_threads)) {
+                tm_config_t config;
+                tm_config_default(&config);
+                config.engine = (tm_engine_t)engine;
+
+                struct run run;
+                run.nums = scenarios[s].nums;
+                run.tm = tm_create_ext(run.nums * sizeof(long long), sizeof(long long), &config);
+                if (run.tm == invalid_shared) {
+                    fprintf(stderr, "Could not create region\n");
+                    return EXIT_FAILURE;
+                }
+                uint64_t start = bench_now_ns();
+                run.deadline_ns = start + (uint64_t)duration_ms * 1000000ull;
+                bench_run_threads(threads, worker, &run);
+                double seconds = (bench_now_ns() - start) / 1e9;
+
+                tm_cm_stats_t stats;
+                tm_cm_stats(run.tm, &stats);
+
+                /* After the stats, the check is not a commit of the run */
+                struct sum sum = {tm_start(run.tm), run.nums, 0};
+                if (!tm_atomic(run.tm, true, sum_body, &sum)) {
+                    fprintf(stderr, "Could not begin transaction\n");
+                    return EXIT_FAILURE;
+                }
+                if (sum.sum != 0) {
+                    fprintf(stderr, "%s,%s,%u: sum of numbers is %lld, not 0\n", engine_names[engine],
+                        scenarios[s].name, threads, sum.sum);
+                    return EXIT_FAILURE;
+                }
+                tm_destroy(run.tm);
+                unsigned long long commits = 0, aborts = 0;
+                for (int cm = 0; cm < TM_CM_COUNT; cm++) {
+                    commits += stats.commits[cm];
+                    aborts += stats.aborts[cm];
+                }
+
+                printf("%s,%s,%u,%llu,%llu,%.3f,%.0f\n", engine_names[engine], scenarios[s].name,
+                    threads, commits, aborts, seconds, commits / seconds);
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
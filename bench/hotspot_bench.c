@@ -0,0 +1,110 @@
+/*
+ * Commit throughput and aborts of writing transactions all moving 1 between
+ * the same two fields, without and with the scheduler of tm_begin
+ * (tm_config_t.scheduler). Transactions are run with tm_begin/tm_end and
+ * retried at once, so only the scheduler keeps retries from colliding.
+ *
+ * Usage: hotspot_bench [max threads] [duration ms]
+ */
+#define _DEFAULT_SOURCE
+
+#include <stdbool.h>
+#include <string.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+
+#include "bench.h"
+
+#define FIELDS 2
+
+struct run {
+    shared_t tm;
+    uint64_t deadline_ns;
+    unsigned long long commits[BENCH_MAX_THREADS];
+    unsigned long long aborts[BENCH_MAX_THREADS];
+};
+
+/*
+ * Move 1 from the first field to the second, false if it aborted
+ */
+static bool transfer(shared_t tm) {
+    uint64_t* fields = (uint64_t*)tm_start(tm);
+    uint64_t from, to;
+    tx_t tx = tm_begin(tm, false);
+    if (tx == invalid_tx) {
+        fprintf(stderr, "Could not begin transaction\n");
+        exit(EXIT_FAILURE);
+    }
+    if (!tm_read(tm, tx, &fields[0], sizeof(from), &from) || !tm_read(tm, tx, &fields[1], sizeof(to), &to))
+        return false;
+    from--;
+    to++;
+    if (!tm_write(tm, tx, &from, sizeof(from), &fields[0]) || !tm_write(tm, tx, &to, sizeof(to), &fields[1]))
+        return false;
+    return tm_end(tm, tx);
+}
+
+static void* worker(void* arg) {
+    bench_thread_t* thread = (bench_thread_t*)arg;
+    struct run* run = (struct run*)thread->arg;
+    unsigned long long commits = 0, aborts = 0;
+    while (bench_now_ns() < run->deadline_ns) {
+        for (int i = 0; i < 64; i++) {
+            while (!transfer(run->tm))
+                aborts++;
+            commits++;
+        }
+    }
+    run->commits[thread->index] = commits;
+    run->aborts[thread->index] = aborts;
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    unsigned max_threads, duration_ms;
+    bench_parse_args(argc, argv, &max_threads, &duration_ms);
+
+    printf("scheduler,threads,commits,aborts,seconds,commits_per_sec,aborts_per_commit\n");
+    for (int scheduler = 0; scheduler < 2; scheduler++) {
+        for (unsigned threads = 1; threads; threads = bench_next_threads(threads, max_threads)) {
+            tm_config_t config;
+            tm_config_default(&config);
+            config.scheduler = scheduler;
+
+            struct run run;
+            memset(&run, 0, sizeof(run));
+            run.tm = tm_create_ext(FIELDS * sizeof(uint64_t), sizeof(uint64_t), &config);
+            if (run.tm == invalid_shared) {
+                fprintf(stderr, "Could not create region\n");
+                return EXIT_FAILURE;
+            }
+            uint64_t start = bench_now_ns();
+            run.deadline_ns = start + (uint64_t)duration_ms * 1000000ull;
+            bench_run_threads(threads, worker, &run);
+            double seconds = (bench_now_ns() - start) / 1e9;
+
+            unsigned long long commits = 0, aborts = 0;
+            for (unsigned i = 0; i < threads; i++) {
+                commits += run.commits[i];
+                aborts += run.aborts[i];
+            }
+            uint64_t fields[FIELDS];
+            tx_t tx = tm_begin(run.tm, true);
+            if (tx == invalid_tx || !tm_read(run.tm, tx, tm_start(run.tm), sizeof(fields), fields) ||
+                !tm_end(run.tm, tx)) {
+                fprintf(stderr, "Could not read fields\n");
+                return EXIT_FAILURE;
+            }
+            tm_destroy(run.tm);
+            if (fields[1] != commits || fields[0] + fields[1] != 0) {
+                fprintf(stderr, "Fields do not match the commits\n");
+                return EXIT_FAILURE;
+            }
+
+            printf("%s,%u,%llu,%llu,%.3f,%.0f,%.3f\n", scheduler ? "on" : "off", threads, commits, aborts,
+                   seconds, commits / seconds, commits ? (double)aborts / (double)commits : 0.0);
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,156 @@
+/*
+ * Commit throughput and cache misses of TL2 under every lock layout.
+ *
+ * In own_line every thread increments its own field, fields are one cache
+ * line each (alignment 64), so threads share no data: with packed layout
+ * their locks still share lines, with padded layout they do not. In random
+ * threads move 1 between two of 64k 8-byte fields chosen at random, where
+ * conflicts are rare and bigger padded metadata costs more misses.
+ *
+ * Misses are per commit, "n/a" if the system provides no counters.
+ *
+ * Usage: layout_bench [max threads] [duration ms]
+ */
+#define _DEFAULT_SOURCE
+
+#include <stdbool.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+
+#include "bench.h"
+#include "bench_perf.h"
+
+static const char* const layout_names[TM_LAYOUT_COUNT] = {
+    "packed", "padded"
+};
+
+struct scenario {
+    const char* name;
+    size_t fields;              /* 0 for one field per thread */
+    size_t align;
+};
+
+static const struct scenario scenarios[] = {
+    {"own_line", 0, 64},
+    {"random", 1 << 16, 8},
+};
+
+struct run {
+    shared_t tm;
+    size_t fields;
+    size_t align;
+    uint64_t deadline_ns;
+};
+
+struct access {
+    char* first;
+    char* second;               /* NULL to increment only the first field */
+    size_t align;
+};
+
+static bool access_body(shared_t tm, tx_t tx, void* arg) {
+    struct access* access = (struct access*)arg;
+    char field[64];
+    long long value;
+
+    if (!tm_read(tm, tx, access->first, access->align, field))
+        return false;
+    memcpy(&value, field, sizeof(value));
+    value++;
+    memcpy(field, &value, sizeof(value));
+    if (!tm_write(tm, tx, field, access->align, access->first))
+        return false;
+    if (!access->second)
+        return true;
+    if (!tm_read(tm, tx, access->second, access->align, field))
+        return false;
+    memcpy(&value, field, sizeof(value));
+    value--;
+    memcpy(field, &value, sizeof(value));
+    return tm_write(tm, tx, field, access->align, access->second);
+}
+
+static void* worker(void* arg) {
+    bench_thread_t* thread = (bench_thread_t*)arg;
+    struct run* run = (struct run*)thread->arg;
+    unsigned seed = thread->index * 7919 + 1;
+    char* start = tm_start(run->tm);
+    struct access access = {start + thread->index * run->align, NULL, run->align};
+
+    while (bench_now_ns() < run->deadline_ns) {
+        for (int i = 0; i < 64; i++) {
+            if (run->fields) {
+                access.first = start + (rand_r(&seed) % run->fields) * run->align;
+                access.second = start + (rand_r(&seed) % run->fields) * run->align;
+                if (access.second == access.first)
+                    access.second = NULL;
+            }
+            if (!tm_atomic(run->tm, false, access_body, &access)) {
+                fprintf(stderr, "Could not begin transaction\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Print misses per commit, or n/a
+ */
+static void print_misses(int64_t misses, unsigned long long commits) {
+    if (misses < 0 || commits == 0)
+        printf(",n/a");
+    else
+        printf(",%.2f", (double)misses / (double)commits);
+}
+
+int main(int argc, char** argv) {
+    unsigned max_threads, duration_ms;
+    bench_parse_args(argc, argv, &max_threads, &duration_ms);
+
+    printf("layout,scenario,threads,commits,aborts,seconds,commits_per_sec,l1d_misses_per_commit,llc_misses_per_commit\n");
+    for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+        for (int layout = 0; layout < TM_LAYOUT_COUNT; layout++) {
+            for (unsigned threads = 1; threads; threads = bench_next_threads(threads, max_threads)) {
+                tm_config_t config;
+                tm_config_default(&config);
+                config.layout = (tm_layout_t)layout;
+
+                struct run run;
+                run.fields = scenarios[s].fields;
+                run.align = scenarios[s].align;
+                size_t fields = run.fields ? run.fields : max_threads;
+                run.tm = tm_create_ext(fields * run.align, run.align, &config);
+                if (run.tm == invalid_shared) {
+                    fprintf(stderr, "Could not create region\n");
+                    return EXIT_FAILURE;
+                }
+                bench_counters_t counters;
+                int64_t misses[BENCH_COUNTERS];
+                bench_counters_open(&counters);
+                uint64_t start = bench_now_ns();
+                run.deadline_ns = start + (uint64_t)duration_ms * 1000000ull;
+                bench_run_threads(threads, worker, &run);
+                double seconds = (bench_now_ns() - start) / 1e9;
+                bench_counters_close(&counters, misses);
+
+                tm_cm_stats_t stats;
+                tm_cm_stats(run.tm, &stats);
+                tm_destroy(run.tm);
+                unsigned long long commits = 0, aborts = 0;
+                for (int cm = 0; cm < TM_CM_COUNT; cm++) {
+                    commits += stats.commits[cm];
+                    aborts += stats.aborts[cm];
+                }
+
+                printf("%s,%s,%u,%llu,%llu,%.3f,%.0f", layout_names[layout], scenarios[s].name,
+                    threads, commits, aborts, seconds, commits / seconds);
+                print_misses(misses[BENCH_L1D_MISSES], commits);
+                print_misses(misses[BENCH_LLC_MISSES], commits);
+                printf("\n");
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,376 @@
+/*
+ * Replay of a trace recorded with tm_config_t.trace (TM_TRACE=<prefix> for
+ * programs using tm_create), against the library this is built with.
+ *
+ * Every recorded thread gets a thread, which re-executes the transactions
+ * the recorded thread commited, in order, retrying each until it commits.
+ * Recorded attempts that aborted are not replayed, the replay aborts on its
+ * own. Writes store the recorded values (zeros for writes too big to be
+ * recorded, see TRACE_VALUE_MAX), read values are discarded.
+ *
+ * Addresses of the trace are translated segment by segment: the first
+ * segment from the header, the others from the tm_alloc that returned them,
+ * once its transaction commits in the replay. Thread that uses a segment
+ * before its allocation was replayed waits for it. Threads are not ordered
+ * otherwise, so a trace where segments are freed while other threads still
+ * use them may not replay.
+ *
+ * Prints one CSV line comparing the recording with the replay, deltas are
+ * relative for throughput and absolute for the abort rate.
+ *
+ * Usage: trace_replay <prefix>.<region id>
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+
+#include "bench.h"
+#include "../src/trace.h"
+
+#define WAIT_SEGMENT_NS 10000000000ull /* Longest wait for an allocation before giving up */
+
+/* Segment of the trace, with its address in the replay */
+struct mapping {
+    uint64_t recorded;
+    uint64_t size;
+    char* replayed;
+};
+
+/* Segments of all threads, sorted by recorded address */
+static struct {
+    pthread_rwlock_t lock;
+    struct mapping* entries;
+    size_t size, size_max;
+    _Atomic(uint64_t) version;  /* Changes whenever a recorded address is mapped again */
+} mappings = { .lock = PTHREAD_RWLOCK_INITIALIZER };
+
+/* Transaction commited in the trace, its records are begin to end */
+struct replayed_tx {
+    size_t first, last;
+};
+
+struct thread {
+    const trace_record_t** records;
+    size_t records_size;
+    struct replayed_tx* txs;
+    size_t txs_size;
+    size_t read_max;            /* Largest read */
+    size_t write_max;           /* Largest write without recorded value */
+    unsigned long long recorded_attempts;
+    uint64_t recorded_first, recorded_last; /* Times of first and last record */
+    unsigned long long attempts;
+};
+
+struct run {
+    shared_t tm;
+    struct thread* threads;
+};
+
+static void* grow(void* array, size_t* size_max, size_t element) {
+    *size_max = *size_max ? 2 * *size_max : 64;
+    void* grown = realloc(array, *size_max * element);
+    if (!grown) {
+        fprintf(stderr, "Could not allocate memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return grown;
+}
+
+/*
+ * Index of the last mapping with recorded address at most given one, or
+ * mappings.size if there is none. Assumes mappings.lock is held
+ */
+static size_t mapping_find(uint64_t address) {
+    size_t low = 0, high = mappings.size;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (mappings.entries[middle].recorded <= address)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low ? low - 1 : mappings.size;
+}
+
+static void mapping_publish(const struct mapping* mapping) {
+    pthread_rwlock_wrlock(&mappings.lock);
+    size_t i = mapping_find(mapping->recorded);
+    if (i < mappings.size && mappings.entries[i].recorded == mapping->recorded) {
+        /* Address was freed and allocated again */
+        mappings.entries[i] = *mapping;
+        atomic_fetch_add(&mappings.version, 1);
+    }
+    else {
+        if (mappings.size == mappings.size_max)
+            mappings.entries = grow(mappings.entries, &mappings.size_max, sizeof(struct mapping));
+        i = i == mappings.size ? 0 : i + 1;
+        memmove(&mappings.entries[i + 1], &mappings.entries[i], (mappings.size - i) * sizeof(struct mapping));
+        mappings.entries[i] = *mapping;
+        mappings.size++;
+    }
+    pthread_rwlock_unlock(&mappings.lock);
+}
+
+/* Translation state of a replaying thread */
+struct translator {
+    struct mapping cached;      /* Last segment used, size 0 if none */
+    uint64_t cached_version;
+    struct mapping pending[64]; /* Segments allocated by the running attempt */
+    size_t pending_size;
+};
+
+static inline bool mapping_contains(const struct mapping* mapping, uint64_t address) {
+    return address - mapping->recorded < mapping->size;
+}
+
+static void* translate(struct translator* translator, uint64_t address) {
+    for (size_t i = 0; i < translator->pending_size; i++) {
+        if (mapping_contains(&translator->pending[i], address))
+            return translator->pending[i].replayed + (address - translator->pending[i].recorded);
+    }
+    uint64_t version = atomic_load_explicit(&mappings.version, memory_order_acquire);
+    if (!(mapping_contains(&translator->cached, address) && translator->cached_version == version)) {
+        uint64_t deadline = bench_now_ns() + WAIT_SEGMENT_NS;
+        for (;;) {
+            pthread_rwlock_rdlock(&mappings.lock);
+            size_t i = mapping_find(address);
+            bool found = i < mappings.size && mapping_contains(&mappings.entries[i], address);
+            if (found)
+                translator->cached = mappings.entries[i];
+            pthread_rwlock_unlock(&mappings.lock);
+            if (found)
+                break;
+            if (bench_now_ns() > deadline) {
+                fprintf(stderr, "Address %#llx is in no segment of the trace\n", (unsigned long long)address);
+                exit(EXIT_FAILURE);
+            }
+            sched_yield(); /* Allocation was not replayed yet */
+        }
+        translator->cached_version = version;
+    }
+    return translator->cached.replayed + (address - translator->cached.recorded);
+}
+
+/*
+ * Run one attempt of a transaction of the trace, false if it aborted
+ */
+static bool replay_attempt(shared_t tm, struct thread* thread, struct replayed_tx* transaction,
+                           struct translator* translator, void* buffer, const void* zeros) {
+    const trace_record_t** records = thread->records;
+    translator->pending_size = 0;
+    tx_t tx = tm_begin(tm, records[transaction->first]->result);
+    if (tx == invalid_tx) {
+        fprintf(stderr, "Could not begin transaction\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = transaction->first + 1; i < transaction->last; i++) {
+        const trace_record_t* record = records[i];
+        void* segment;
+        switch (record->op) {
+        case TRACE_READ:
+            if (!tm_read(tm, tx, translate(translator, record->address), record->size, buffer))
+                return false;
+            break;
+        case TRACE_WRITE: {
+            const void* value = record->size <= TRACE_VALUE_MAX ? (const void*)(record + 1) : zeros;
+            if (!tm_write(tm, tx, value, record->size, translate(translator, record->address)))
+                return false;
+            break;
+        }
+        case TRACE_ALLOC:
+            if (record->result != success_alloc)
+                break; /* Recorded thread went on without the segment */
+            switch (tm_alloc(tm, tx, record->size, &segment)) {
+            case success_alloc:
+                if (translator->pending_size == sizeof(translator->pending) / sizeof(translator->pending[0])) {
+                    fprintf(stderr, "Too many allocations in one transaction\n");
+                    exit(EXIT_FAILURE);
+                }
+                translator->pending[translator->pending_size++] = (struct mapping){
+                    record->address, record->size, (char*)segment };
+                break;
+            case abort_alloc:
+                return false;
+            default:
+                fprintf(stderr, "Could not allocate segment\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case TRACE_FREE:
+            if (!tm_free(tm, tx, translate(translator, record->address)))
+                return false;
+            break;
+        }
+    }
+    if (!tm_end(tm, tx))
+        return false;
+    for (size_t i = 0; i < translator->pending_size; i++)
+        mapping_publish(&translator->pending[i]);
+    return true;
+}
+
+static void* replay(void* arg) {
+    bench_thread_t* bench_thread = (bench_thread_t*)arg;
+    struct run* run = (struct run*)bench_thread->arg;
+    struct thread* thread = &(run->threads[bench_thread->index]);
+    struct translator translator;
+    memset(&translator, 0, sizeof(translator));
+    void* buffer = malloc(thread->read_max + 1);
+    void* zeros = calloc(1, thread->write_max + 1);
+    if (!buffer || !zeros) {
+        fprintf(stderr, "Could not allocate buffers\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < thread->txs_size; i++) {
+        do {
+            thread->attempts++;
+        } while (!replay_attempt(run->tm, thread, &(thread->txs[i]), &translator, buffer, zeros));
+    }
+    free(zeros);
+    free(buffer);
+    return NULL;
+}
+
+/*
+ * Map the trace file and split its records into transactions
+ */
+static bool load(const char* path, struct thread* thread, struct trace_header* header) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat status;
+    if (fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(struct trace_header)) {
+        fprintf(stderr, "Trace file %s is truncated\n", path);
+        exit(EXIT_FAILURE);
+    }
+    size_t length = (size_t)status.st_size;
+    const char* data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Could not map %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    memcpy(header, data, sizeof(*header));
+    if (memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0 || header->chunk == 0) {
+        fprintf(stderr, "%s is not a trace\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    memset(thread, 0, sizeof(*thread));
+    size_t records_max = 0, txs_max = 0, begin = 0;
+    bool running = false;
+    for (size_t position = sizeof(struct trace_header); position + sizeof(trace_record_t) <= length;) {
+        size_t chunk_left = header->chunk - position % header->chunk;
+        const trace_record_t* record = (const trace_record_t*)(data + position);
+        if (chunk_left < sizeof(trace_record_t) || record->op == TRACE_PAD) {
+            position += chunk_left;
+            continue;
+        }
+        if (record->op == TRACE_END_OF_FILE)
+            break;
+        position += trace_record_size((enum trace_op)record->op, record->size);
+
+        if (thread->records_size == records_max)
+            thread->records = grow(thread->records, &records_max, sizeof(trace_record_t*));
+        if (thread->records_size == 0)
+            thread->recorded_first = record->time;
+        thread->recorded_last = record->time;
+        thread->records[thread->records_size++] = record;
+        if (record->op == TRACE_READ && record->size > thread->read_max)
+            thread->read_max = record->size;
+        if (record->op == TRACE_WRITE && record->size > TRACE_VALUE_MAX && record->size > thread->write_max)
+            thread->write_max = record->size;
+
+        if (record->op == TRACE_BEGIN) {
+            running = true;
+            begin = thread->records_size - 1;
+            thread->recorded_attempts++;
+        }
+        else if (running && record->op == TRACE_END && record->result) {
+            running = false;
+            if (thread->txs_size == txs_max)
+                thread->txs = grow(thread->txs, &txs_max, sizeof(struct replayed_tx));
+            thread->txs[thread->txs_size++] = (struct replayed_tx){ begin, thread->records_size - 1 };
+        }
+        else if (record->op == TRACE_END || (record->op != TRACE_ALLOC && !record->result)) {
+            running = false; /* Attempt aborted */
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <prefix>.<region id>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    struct thread threads[BENCH_MAX_THREADS];
+    struct trace_header header;
+    unsigned count = 0;
+    for (; count < BENCH_MAX_THREADS; count++) {
+        char path[4096];
+        struct trace_header thread_header;
+        snprintf(path, sizeof(path), "%s.%u", argv[1], count);
+        if (!load(path, &threads[count], &thread_header))
+            break;
+        if (count == 0)
+            header = thread_header;
+    }
+    if (count == 0) {
+        fprintf(stderr, "No trace file %s.0\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    struct run run;
+    run.threads = threads;
+    run.tm = tm_create(header.size, header.align);
+    if (run.tm == invalid_shared) {
+        fprintf(stderr, "Could not create region\n");
+        return EXIT_FAILURE;
+    }
+    mapping_publish(&(struct mapping){ header.start, header.size, tm_start(run.tm) });
+
+    uint64_t start = bench_now_ns();
+    bench_run_threads(count, replay, &run);
+    double seconds = (bench_now_ns() - start) / 1e9;
+    tm_destroy(run.tm);
+
+    unsigned long long commits = 0, recorded_attempts = 0, attempts = 0;
+    uint64_t first = UINT64_MAX, last = 0;
+    for (unsigned i = 0; i < count; i++) {
+        commits += threads[i].txs_size;
+        recorded_attempts += threads[i].recorded_attempts;
+        attempts += threads[i].attempts;
+        if (threads[i].records_size && threads[i].recorded_first < first)
+            first = threads[i].recorded_first;
+        if (threads[i].recorded_last > last)
+            last = threads[i].recorded_last;
+    }
+    double recorded_seconds = last > first ? (last - first) / 1e9 : 0.0;
+    double recorded_rate = recorded_seconds > 0 ? commits / recorded_seconds : 0.0;
+    double rate = seconds > 0 ? commits / seconds : 0.0;
+    double recorded_abort_rate = recorded_attempts ? (double)(recorded_attempts - commits) / (double)recorded_attempts : 0.0;
+    double abort_rate = attempts ? (double)(attempts - commits) / (double)attempts : 0.0;
+
+    printf("threads,commits,recorded_aborts,recorded_seconds,recorded_commits_per_sec,"
+           "replay_aborts,replay_seconds,replay_commits_per_sec,commits_per_sec_delta,abort_rate_delta\n");
+    printf("%u,%llu,%llu,%.3f,%.0f,%llu,%.3f,%.0f,%+.4f,%+.4f\n", count, commits,
+           recorded_attempts - commits, recorded_seconds, recorded_rate, attempts - commits, seconds, rate,
+           recorded_rate > 0 ? rate / recorded_rate - 1 : 0.0, abort_rate - recorded_abort_rate);
+    for (unsigned i = 0; i < count; i++) {
+        free(threads[i].records);
+        free(threads[i].txs);
+    }
+    free(mappings.entries);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+/*
+ * Speed of read set validation kernels as the read set grows.
+ *
+ * Read set of n entries points to locks scattered over 4n locks (in random
+ * order, as reads of a large transaction are), and every entry is valid, so
+ * kernels always scan the whole set. Kernels the CPU does not support are
+ * skipped.
+ *
+ * Usage: validate_bench [duration ms]
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+
+#include "bench.h"
+#include "../src/validate.h"
+
+#define LOCKS_PER_ENTRY 4
+
+static const size_t sizes[] = { 10, 30, 100, 300, 1000, 3000, 10000 };
+
+/*
+ * Read set of n entries over 4n locks, in random order
+ */
+static read_entry_t* make_entries(vlock_t* locks, size_t n, unsigned* seed) {
+    size_t count = n * LOCKS_PER_ENTRY;
+    size_t* order = (size_t*)malloc(count * sizeof(size_t));
+    read_entry_t* entries = (read_entry_t*)malloc(n * sizeof(read_entry_t));
+    if (!order || !entries) {
+        fprintf(stderr, "Could not allocate read set\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        order[i] = i;
+        atomic_init(&(locks[i]), vlock_free_word(i % 1000));
+    }
+    for (size_t i = count - 1; i > 0; --i) {
+        size_t j = (size_t)rand_r(seed) % (i + 1);
+        size_t swap = order[i];
+        order[i] = order[j];
+        order[j] = swap;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        entries[i].lock = &(locks[order[i]]);
+        entries[i].version = order[i] % 1000;
+    }
+    free(order);
+    return entries;
+}
+
+int main(int argc, char** argv) {
+    unsigned duration_ms = argc > 1 ? (unsigned)atoi(argv[1]) : 200;
+    unsigned seed = 1;
+
+    printf("kernel,entries,validations,ns_per_validation,ns_per_entry\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        size_t n = sizes[s];
+        vlock_t* locks = (vlock_t*)malloc(n * LOCKS_PER_ENTRY * sizeof(vlock_t));
+        if (!locks) {
+            fprintf(stderr, "Could not allocate locks\n");
+            return EXIT_FAILURE;
+        }
+        read_entry_t* entries = make_entries(locks, n, &seed);
+
+        for (int isa = 0; isa < VALIDATE_ISA_COUNT; ++isa) {
+            validate_kernel_t kernel = validate_kernel_of((validate_isa_t)isa);
+            if (!kernel)
+                continue;
+            uint64_t validations = 0;
+            uint64_t start = bench_now_ns();
+            uint64_t deadline = start + (uint64_t)duration_ms * 1000000ull;
+            uint64_t now;
+            do {
+                /* Check time only every few validations, small sets are fast */
+                for (unsigned k = 0; k < 64; ++k) {
+                    if (kernel(entries, n) != n) {
+                        fprintf(stderr, "Kernel %s rejected valid read set\n", validate_isa_names[isa]);
+                        return EXIT_FAILURE;
+                    }
+                }
+                validations += 64;
+                now = bench_now_ns();
+            } while (now < deadline);
+            double ns = (double)(now - start) / (double)validations;
+            printf("%s,%zu,%llu,%.1f,%.3f\n", validate_isa_names[isa], n,
+                   (unsigned long long)validations, ns, ns / (double)n);
+        }
+        free(entries);
+        free(locks);
+    }
+    return 0;
+}
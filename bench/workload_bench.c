@@ -0,0 +1,300 @@
+/*
+ * Throughput and latency on the workload mix of the grader (see my_tests.c),
+ * as threads scale.
+ *
+ * Accounts are 8-byte fields of the first segment, every access is one
+ * field. Threads run, half and half:
+ * - read-only transactions summing all accounts (checking the total),
+ * - small read-write transactions reading up to 40 accounts and moving
+ *   money between 2 or 3 of them.
+ * One read-write transaction in OUTLIER_PERIOD instead writes 129 fields of
+ * a scratch segment, and one in ALLOC_PERIOD replaces the 1048-byte segment
+ * the thread owns (tm_free of the old one, tm_alloc of a new one).
+ *
+ * Latency of a transaction includes its retries. One CSV line per thread
+ * count and kind of transaction (all, ro, rw). If the library collects
+ * statistics (make STATS=1), aborts per reason and the fields that caused
+ * most of them are reported on stderr.
+ *
+ * Usage: workload_bench [max threads] [duration ms]
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <string.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+
+#include "bench.h"
+
+#define ACCOUNTS 1000
+#define INITIAL_BALANCE 100
+#define RW_MAX_READS 40
+#define OUTLIER_WRITES 129
+#define OUTLIER_PERIOD 10000
+#define ALLOC_SIZE 1048
+#define ALLOC_PERIOD 4096
+#define HOT_FIELDS 8
+
+enum { KIND_RO = 0, KIND_RW, KINDS };
+
+static const char* const kind_names[KINDS] = { "ro", "rw" };
+
+struct result {
+    bench_hist_t latency[KINDS];
+    unsigned long long commits[KINDS];
+    unsigned long long attempts[KINDS];
+    bool broken;                /* Read-only transaction saw wrong total */
+};
+
+struct run {
+    shared_t tm;
+    void* scratch;              /* Segment written by outliers */
+    uint64_t deadline_ns;
+    struct result* results;
+};
+
+/* Arguments and counters of the bodies, per thread */
+struct context {
+    char* accounts;
+    char* scratch;
+    void* owned;                /* Segment allocated by the thread, or NULL */
+    void* allocated;            /* Segment allocated by the running transaction */
+    unsigned seed;
+    unsigned long long attempts;
+    long long total;            /* Sum of accounts seen by the last read-only transaction */
+    enum { RW_TRANSFER, RW_OUTLIER, RW_ALLOC } rw;
+};
+
+static bool ro_body(shared_t tm, tx_t tx, void* arg) {
+    struct context* context = (struct context*)arg;
+    context->attempts++;
+    long long total = 0;
+    for (size_t i = 0; i < ACCOUNTS; i++) {
+        long long balance;
+        if (!tm_read(tm, tx, context->accounts + i * sizeof(long long), sizeof(balance), &balance))
+            return false;
+        total += balance;
+    }
+    context->total = total;
+    return true;
+}
+
+static bool transfer(shared_t tm, tx_t tx, struct context* context) {
+    /* Reads are chosen before, so that retries repeat the same transaction */
+    unsigned seed = context->seed;
+    size_t writes = 2 + (size_t)rand_r(&seed) % 2;
+    size_t reads = writes + (size_t)rand_r(&seed) % (RW_MAX_READS - writes + 1);
+    size_t accounts[RW_MAX_READS];
+    long long balances[RW_MAX_READS];
+    for (size_t i = 0; i < reads; i++) {
+        accounts[i] = (size_t)rand_r(&seed) % ACCOUNTS;
+        /* Written accounts are distinct, so the total is kept */
+        for (size_t j = 0; j < i && i < writes; j++) {
+            if (accounts[j] == accounts[i]) {
+                accounts[i] = (accounts[i] + 1) % ACCOUNTS;
+                j = (size_t)-1;
+            }
+        }
+        if (!tm_read(tm, tx, context->accounts + accounts[i] * sizeof(long long), sizeof(long long), &(balances[i])))
+            return false;
+    }
+    /* First account pays the others 1 each */
+    balances[0] -= (long long)(writes - 1);
+    for (size_t i = 1; i < writes; i++)
+        balances[i]++;
+    for (size_t i = 0; i < writes; i++) {
+        if (!tm_write(tm, tx, &(balances[i]), sizeof(long long), context->accounts + accounts[i] * sizeof(long long)))
+            return false;
+    }
+    return true;
+}
+
+static bool outlier(shared_t tm, tx_t tx, struct context* context) {
+    long long value = (long long)context->seed;
+    for (size_t i = 0; i < OUTLIER_WRITES; i++) {
+        if (!tm_write(tm, tx, &value, sizeof(value), context->scratch + i * sizeof(long long)))
+            return false;
+    }
+    return true;
+}
+
+static bool replace_segment(shared_t tm, tx_t tx, struct context* context) {
+    void* segment;
+    if (context->owned && !tm_free(tm, tx, context->owned))
+        return false;
+    switch (tm_alloc(tm, tx, ALLOC_SIZE, &segment)) {
+    case success_alloc:
+        break;
+    case abort_alloc:
+        return false;
+    default:
+        fprintf(stderr, "Could not allocate segment\n");
+        exit(EXIT_FAILURE);
+    }
+    long long value = 1;
+    /* Segment is only owned once the transaction commits */
+    context->allocated = segment;
+    return tm_write(tm, tx, &value, sizeof(value), segment);
+}
+
+static bool rw_body(shared_t tm, tx_t tx, void* arg) {
+    struct context* context = (struct context*)arg;
+    context->attempts++;
+    switch (context->rw) {
+    case RW_OUTLIER:
+        return outlier(tm, tx, context);
+    case RW_ALLOC:
+        return replace_segment(tm, tx, context);
+    default:
+        return transfer(tm, tx, context);
+    }
+}
+
+/*
+ * Run one transaction of given kind until it commits, recording its latency
+ */
+static void run_transaction(struct run* run, struct result* result, struct context* context, int kind) {
+    context->attempts = 0;
+    uint64_t start = bench_now_ns();
+    bool committed;
+    if (kind == KIND_RO)
+        committed = tm_atomic(run->tm, true, ro_body, context);
+    else
+        committed = tm_atomic(run->tm, false, rw_body, context);
+    if (!committed) {
+        fprintf(stderr, "Could not begin transaction\n");
+        exit(EXIT_FAILURE);
+    }
+    if (kind == KIND_RW && context->rw == RW_ALLOC)
+        context->owned = context->allocated;
+    bench_hist_add(&(result->latency[kind]), bench_now_ns() - start);
+    result->commits[kind]++;
+    result->attempts[kind] += context->attempts;
+    if (kind == KIND_RO && context->total != (long long)ACCOUNTS * INITIAL_BALANCE)
+        result->broken = true;
+}
+
+static void* worker(void* arg) {
+    bench_thread_t* thread = (bench_thread_t*)arg;
+    struct run* run = (struct run*)thread->arg;
+    struct result* result = &(run->results[thread->index]);
+    struct context context;
+    memset(&context, 0, sizeof(context));
+    context.accounts = tm_start(run->tm);
+    context.scratch = run->scratch;
+    context.seed = thread->index * 7919 + 1;
+    unsigned long long rw_count = 0;
+
+    while (bench_now_ns() < run->deadline_ns) {
+        for (int i = 0; i < 16; i++) {
+            int kind = rand_r(&(context.seed)) % 2 ? KIND_RW : KIND_RO;
+            if (kind == KIND_RW) {
+                rw_count++;
+                context.rw = RW_TRANSFER;
+                if (rw_count % OUTLIER_PERIOD == 0)
+                    context.rw = RW_OUTLIER;
+                else if (rw_count % ALLOC_PERIOD == 0)
+                    context.rw = RW_ALLOC;
+            }
+            run_transaction(run, result, &context, kind);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Region with accounts holding INITIAL_BALANCE each and the scratch segment
+ */
+static bool setup(struct run* run) {
+    run->tm = tm_create(ACCOUNTS * sizeof(long long), sizeof(long long));
+    if (run->tm == invalid_shared)
+        return false;
+    char* accounts = tm_start(run->tm);
+    long long balance = INITIAL_BALANCE;
+    tx_t tx = tm_begin(run->tm, false);
+    if (tx == invalid_tx || tm_alloc(run->tm, tx, ALLOC_SIZE, &(run->scratch)) != success_alloc)
+        return false;
+    for (size_t i = 0; i < ACCOUNTS; i++) {
+        if (!tm_write(run->tm, tx, &balance, sizeof(balance), accounts + i * sizeof(long long)))
+            return false;
+    }
+    return tm_end(run->tm, tx);
+}
+
+static void report_conflicts(shared_t tm, unsigned threads) {
+    static const char* const reasons[TM_ABORT_COUNT] = { "locked", "snapshot", "lock", "validation", "nomem", "body", "segment" };
+    tm_stats_t stats;
+    tm_stats(tm, &stats);
+    if (!stats.enabled)
+        return;
+    fprintf(stderr, "# %u threads, aborts:", threads);
+    for (int i = 0; i < TM_ABORT_COUNT; i++)
+        fprintf(stderr, " %s=%llu", reasons[i], (unsigned long long)stats.aborts[i]);
+    fprintf(stderr, "\n");
+
+    tm_hot_field_t fields[HOT_FIELDS];
+    size_t count = tm_hot_fields(tm, fields, HOT_FIELDS);
+    for (size_t i = 0; i < count; i++) {
+        fprintf(stderr, "# hot field segment=%u field=%llu conflicts=%llu\n", fields[i].segment,
+            (unsigned long long)fields[i].field, (unsigned long long)fields[i].conflicts);
+    }
+}
+
+static void print_line(unsigned threads, const char* kind, const bench_hist_t* latency,
+                       unsigned long long commits, unsigned long long attempts, double seconds) {
+    unsigned long long aborts = attempts - commits;
+    printf("%u,%s,%llu,%llu,%.4f,%.3f,%.0f,%llu,%llu\n", threads, kind, commits, aborts,
+        attempts ? (double)aborts / (double)attempts : 0.0, seconds, commits / seconds,
+        (unsigned long long)bench_hist_percentile(latency, 0.5),
+        (unsigned long long)bench_hist_percentile(latency, 0.99));
+}
+
+int main(int argc, char** argv) {
+    unsigned max_threads, duration_ms;
+    bench_parse_args(argc, argv, &max_threads, &duration_ms);
+
+    printf("threads,kind,commits,aborts,abort_rate,seconds,commits_per_sec,p50_ns,p99_ns\n");
+    for (unsigned threads = 1; threads; threads = bench_next_threads(threads, max_threads)) {
+        struct run run;
+        run.results = (struct result*)calloc(threads, sizeof(struct result));
+        if (!run.results || !setup(&run)) {
+            fprintf(stderr, "Could not create region\n");
+            return EXIT_FAILURE;
+        }
+        uint64_t start = bench_now_ns();
+        run.deadline_ns = start + (uint64_t)duration_ms * 1000000ull;
+        bench_run_threads(threads, worker, &run);
+        double seconds = (bench_now_ns() - start) / 1e9;
+        report_conflicts(run.tm, threads);
+        tm_destroy(run.tm);
+
+        struct result total;
+        memset(&total, 0, sizeof(total));
+        bench_hist_t all;
+        memset(&all, 0, sizeof(all));
+        for (unsigned t = 0; t < threads; t++) {
+            for (int kind = 0; kind < KINDS; kind++) {
+                bench_hist_merge(&(total.latency[kind]), &(run.results[t].latency[kind]));
+                total.commits[kind] += run.results[t].commits[kind];
+                total.attempts[kind] += run.results[t].attempts[kind];
+            }
+            total.broken |= run.results[t].broken;
+        }
+        free(run.results);
+        if (total.broken) {
+            fprintf(stderr, "Read-only transaction saw wrong total with %u threads\n", threads);
+            return EXIT_FAILURE;
+        }
+
+        for (int kind = 0; kind < KINDS; kind++)
+            bench_hist_merge(&all, &(total.latency[kind]));
+        print_line(threads, "all", &all, total.commits[KIND_RO] + total.commits[KIND_RW],
+            total.attempts[KIND_RO] + total.attempts[KIND_RW], seconds);
+        for (int kind = 0; kind < KINDS; kind++)
+            print_line(threads, kind_names[kind], &(total.latency[kind]), total.commits[kind],
+                total.attempts[kind], seconds);
+    }
+    return EXIT_SUCCESS;
+}
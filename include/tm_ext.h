@@ -0,0 +1,211 @@
+/**
+ * @file   tm_ext.h
+ *
+ * @section DESCRIPTION
+ *
+ * Extensions of the transaction manager interface declared in tm.h, for
+ * tuning a region at creation time (C version).
+**/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <tm.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -------------------------------------------------------------------------- //
+
+/** Schemes of the global version clock (named after TL2 GV variants).
+**/
+typedef enum tm_clock {
+    TM_CLOCK_GV1 = 0,       // Fetch-and-add on every writing commit (default)
+    TM_CLOCK_GV4,           // CAS once, on failure share the timestamp of the winner
+    TM_CLOCK_GV5,           // Commit with clock + 1 without incrementing, increment on aborts
+    TM_CLOCK_GV6,           // GV1 for one in 32 commits, GV5 for the others
+    TM_CLOCK_PARTITIONED,   // Per-thread partitions, clock is their maximum
+    TM_CLOCK_COUNT
+} tm_clock_t;
+
+/** Algorithms running transactions of a region.
+**/
+typedef enum tm_engine {
+    TM_ENGINE_TL2 = 0,      // Per-field versioned locks, commit-time locking (default)
+    TM_ENGINE_NOREC,        // One global sequence lock, value-based validation, no per-field metadata
+    TM_ENGINE_ETL,          // Encounter-time locking, write-through with undo log (TinySTM style)
+    TM_ENGINE_COUNT
+} tm_engine_t;
+
+/** Layouts of metadata (versioned locks) of fields.
+**/
+typedef enum tm_layout {
+    TM_LAYOUT_PACKED = 0,   // Locks of adjacent fields are adjacent, 8 per cache line (default)
+    TM_LAYOUT_PADDED,       // Every lock in its own cache line, locks of hot fields never false-share
+    TM_LAYOUT_COUNT
+} tm_layout_t;
+
+/** Contention management policies of tm_atomic.
+**/
+typedef enum tm_cm {
+    TM_CM_IMMEDIATE = 0,    // Retry aborted transaction immediately (default)
+    TM_CM_BACKOFF,          // Retry after randomized exponential backoff
+    TM_CM_KARMA,            // Priority grows with aborts, commits with higher priority wait for locks
+    TM_CM_COUNT
+} tm_cm_t;
+
+/** Parameters of a region, fixed at its creation.
+**/
+typedef struct tm_config {
+    tm_engine_t engine;     // Algorithm, only TL2 supports multi-version, NOrec only the default clock
+    tm_clock_t clock;       // Scheme of the global version clock
+    tm_cm_t cm;             // Initial contention management policy of tm_atomic
+    tm_layout_t layout;     // Layout of versioned locks, ignored by NOrec which has none
+    bool multi_version;     // Keep old values of fields, so read-only transactions never abort
+    bool direct_mapped;     // Reserve one address space for all segments, addresses translate without lookups (not with multi_version)
+    bool scheduler;         // Queue writing transactions of threads that abort often behind running ones predicted to write the same fields
+    const char* trace;      // Record tm_* calls to files <trace>.<region id>.<thread index> (see bench/trace_replay), NULL not to record
+} tm_config_t;
+
+/** Commits and aborts of transactions run by tm_atomic, per policy they ran under.
+**/
+typedef struct tm_cm_stats {
+    uint64_t commits[TM_CM_COUNT];
+    uint64_t aborts[TM_CM_COUNT];
+} tm_cm_stats_t;
+
+/** Memory held by old versions of fields, in multi-version regions.
+**/
+typedef struct tm_mv_stats {
+    uint64_t versions;      // Old versions retained, in chains or waiting for reclamation
+    uint64_t version_bytes; // Bytes allocated for one retained version
+    uint64_t bytes;         // Bytes allocated for all retained versions
+} tm_mv_stats_t;
+
+/** Reasons of aborts, counted by tm_stats.
+**/
+typedef enum tm_abort_reason {
+    TM_ABORT_LOCKED = 0,    // Read field was locked by a committing writer
+    TM_ABORT_SNAPSHOT,      // Read field was newer than the snapshot, which could not be extended
+    TM_ABORT_LOCK,          // Lock of a written field could not be acquired
+    TM_ABORT_VALIDATION,    // Value read before was overwritten, found by validation
+    TM_ABORT_NOMEM,         // Memory for the read or write set could not be allocated
+    TM_ABORT_BODY,          // Body of tm_atomic returned false while the transaction was running
+    TM_ABORT_SEGMENT,       // Address was in a freed segment (whose number may have been reused)
+    TM_ABORT_COUNT
+} tm_abort_reason_t;
+
+#define TM_STATS_LATENCY_BUCKETS 32 // Commit latency bucket i counts commits of [2^i, 2^(i+1)) ns, the last one also longer
+
+/** Statistics of all transactions, collected only if the library is built
+ * with them (make STATS=1), all zeros otherwise.
+**/
+typedef struct tm_stats {
+    bool enabled;           // Whether the library collects statistics
+    uint64_t commits;       // Read-only commits included
+    uint64_t ro_commits;
+    uint64_t aborts[TM_ABORT_COUNT];
+    uint64_t read_set_entries;  // Sum of read set sizes of commits (NOrec: values read)
+    uint64_t write_set_entries; // Sum of write set sizes of commits
+    uint64_t read_set_max;  // Largest read set of a commit
+    uint64_t write_set_max; // Largest write set of a commit
+    uint64_t commit_latency[TM_STATS_LATENCY_BUCKETS]; // Commits per time spent in tm_end
+} tm_stats_t;
+
+/** Field whose conflicts caused aborts, reported by tm_hot_fields.
+**/
+typedef struct tm_hot_field {
+    void* address;          // Virtual address of the field
+    uint32_t segment;       // Number of its segment in addresses (first segment: 65535), UINT32_MAX if direct-mapped
+    uint64_t field;         // Index of the field in its segment (direct-mapped: in the address space)
+    uint64_t conflicts;     // Estimated aborts the field caused, may overcount
+} tm_hot_field_t;
+
+/** Body of a transaction run by tm_atomic.
+ * @param shared Shared memory region the transaction runs on
+ * @param tx     Transaction to execute the body in
+ * @param arg    Argument given to tm_atomic
+ * @return Whether the body finished, false if any tm_* call aborted the transaction,
+ *         or to abort it (tm_atomic then aborts it and runs the body again)
+**/
+typedef bool (*tm_body_t)(shared_t shared, tx_t tx, void* arg);
+
+// -------------------------------------------------------------------------- //
+
+/** Fill the configuration with defaults, which tm_create uses. Calls are
+ * recorded if the environment variable TM_TRACE is set, to its value.
+ * @param config Configuration to fill
+**/
+void tm_config_default(tm_config_t* config);
+
+/** Same as tm_create, with given configuration.
+ * @param size   Size of the first shared segment of memory to allocate (in bytes)
+ * @param align  Alignment (in bytes, must be a power of 2)
+ * @param config Configuration of the region, NULL for defaults
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+**/
+shared_t tm_create_ext(size_t size, size_t align, tm_config_t const* config);
+
+/** Run body in a transaction until it commits, managing contention between
+ * retries with the current policy of the region. The body may run many
+ * times, so it must not have side effects outside the transaction. Body
+ * that returns false without a failed tm_* call has its transaction aborted.
+ * @param shared Shared memory region to run the transaction on
+ * @param is_ro  Whether the transaction is read-only
+ * @param body   Body of the transaction
+ * @param arg    Argument of the body
+ * @return Whether the transaction commited, false only if it could not begin
+**/
+bool tm_atomic(shared_t shared, bool is_ro, tm_body_t body, void* arg);
+
+/** Change contention management policy of tm_atomic.
+ * @param shared Shared memory region
+ * @param cm     New policy
+**/
+void tm_set_cm(shared_t shared, tm_cm_t cm);
+
+/** Sum commits and aborts of tm_atomic over all threads.
+ * @param shared Shared memory region
+ * @param stats  Filled with counts, per policy
+**/
+void tm_cm_stats(shared_t shared, tm_cm_stats_t* stats);
+
+/** Sum memory of retained old versions over all threads, zeros unless the
+ * region is multi-version.
+ * @param shared Shared memory region
+ * @param stats  Filled with counts
+**/
+void tm_mv_stats(shared_t shared, tm_mv_stats_t* stats);
+
+/** Sum statistics of transactions over all threads, since the region was
+ * created or last reset. Counts of running transactions may be partial.
+ * @param shared Shared memory region
+ * @param stats  Filled with counts
+**/
+void tm_stats(shared_t shared, tm_stats_t* stats);
+
+/** Start counting statistics of transactions from zero, so that tm_stats
+ * covers an interval.
+ * @param shared Shared memory region
+**/
+void tm_stats_reset(shared_t shared);
+
+/** Report fields that caused the most aborts, since the region was created
+ * or its statistics were last reset. Conflicts of TL2 and ETL are sampled
+ * where a read finds its field locked or newer than the snapshot, a commit
+ * can not lock a written field, or validation finds a read field changed. Collected only with
+ * statistics (see tm_stats_t), no fields are reported otherwise.
+ * @param shared Shared memory region
+ * @param fields Filled with the fields, most conflicting first
+ * @param k      Most fields to report
+ * @return Number of reported fields, at most k
+**/
+size_t tm_hot_fields(shared_t shared, tm_hot_field_t* fields, size_t k);
+
+#ifdef __cplusplus
+}
+#endif
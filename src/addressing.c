@@ -1,58 +1,56 @@
 #include <stdio.h>
 
 #include "addressing.h"
+#include "direct.h"
 
 
 /*
- * Recover segment number from address in memory,
- * segment number is encoded in the first 16 bits of the address,
- * Next 48 bits of the address is the offset in the segment.
+ * Build virtual address from given segment number, generation and segment offset.
+ * It is assumed, that segment number is not bigger then 65535, generation is
+ * not bigger then 65535 and that segment offset is not bigger then 4294967295
  */
-uint32_t get_segment_num(const void* address) {
-	return ((uint64_t)address) >> 48;
+void* build_virtual_address(uint32_t segment_num, uint32_t generation, uint64_t segment_offset) {
+	return (void*)(((uint64_t)segment_num << 48) | 
+	               ((uint64_t)(generation & SEGMENT_GENERATION_MASK) << 32) | 
+	               segment_offset);
 }
 
 /*
- * Recover offset in segment from given address,
- * segment offset is coded by the last 48 bits of the addresss.
+ * Virtual address of the first byte of given segment
  */
-uint64_t get_segment_offset(const void* address) {
-	return ((((uint64_t)address) << 16) >> 16);
+void* segment_address(const region_t* region, const segment_descriptor_t* desc) {
+	if (region->direct)
+		return direct_address(region, desc);
+	return build_virtual_address(desc->num, desc->generation, 0);
 }
 
 /*
- * Build virtual address from given segment number and segment offset.
- * It is assumed, that segment number is not bigger then 65535, 
- * and that segment offset is not bigger then 281474976710655
- */
-void* build_virtual_address(uint32_t segment_num, uint64_t segment_offset) {
-	return (void*)(((uint64_t)segment_num << 48) | segment_offset);
-}
-
-/*
- * Finds segment to which given virtual address belongs, and returns pointer to this segment
+ * Finds segment to which given virtual address belongs, and returns pointer to this segment.
+ * Direct-mapped region translates all addresses with one descriptor.
+ * NULL if the address is stale: its segment was freed, and the number is
+ * free or reused under another generation (unless all 65536 passed since)
  */
 segment_descriptor_t* find_segment(const region_t* region, const void* address) {
+	if (region->direct)
+		return region->direct;
 	uint32_t segment_num = get_segment_num(address);
 	if (segment_num == DEFAULT_SEGMENT_NUM) {
 		/* The builtin default region segment */
 		return region->desc;
 	}
-	return region->allocs->data[segment_num];
+	segment_descriptor_t* desc = segment_dir_get(&(region->segments), segment_num);
+	if (unlikely(!desc || desc->generation != get_segment_generation(address)))
+		return NULL;
+	return desc;
 }
 
-/*
- * Find the number of accessed field in given segment
- */
-size_t find_field_number(const segment_descriptor_t* desc, const void* address) {
-	return (size_t)(get_segment_offset(address) / desc->align);
-}
 
 /*
- * Get the real address of memory of given virtual address two 
- * transactional memory 
+ * Finds segment which was allocated at given virtual address (its first byte),
+ * for freeing it, NULL if there is none (see find_segment)
  */
-void* get_physical_address(const segment_descriptor_t* desc, const void* address) {
-	uint64_t segment_offset = get_segment_offset(address);
-	return desc->data + segment_offset;
+segment_descriptor_t* find_allocation(const region_t* region, const void* address) {
+	if (region->direct)
+		return direct_segment_of(region, address);
+	return find_segment(region, address);
 }
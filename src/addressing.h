@@ -3,12 +3,71 @@
 #include <stdint.h>
 
 #include "structs.h"
+#include "segment_dir.h"
 
 #define DEFAULT_SEGMENT_NUM 65535 
+#define SEGMENT_GENERATION_MASK 0xFFFFu
+#define SEGMENT_OFFSET_MASK 0xFFFFFFFFull
+#define SEGMENT_MAX_SIZE (SEGMENT_OFFSET_MASK + 1)
 
-uint32_t get_segment_num(const void* address);
-uint64_t get_segment_offset(const void* address);
-void* build_virtual_address(uint32_t segment_num, uint64_t segment_offset);
+void* build_virtual_address(uint32_t segment_num, uint32_t generation, uint64_t segment_offset);
+void* segment_address(const region_t* region, const segment_descriptor_t* desc);
 segment_descriptor_t* find_segment(const region_t* region, const void* address);
-size_t find_field_number(const segment_descriptor_t* desc, const void* address);
-void* get_physical_address(const segment_descriptor_t* desc, const void* address);
+segment_descriptor_t* find_allocation(const region_t* region, const void* address);
+
+/*
+ * Recover segment number from address in memory,
+ * segment number is encoded in the first 16 bits of the address,
+ * next 16 bits are generation of the segment (segment numbers are reused),
+ * last 32 bits of the address is the offset in the segment.
+ */
+static inline uint32_t get_segment_num(const void* address) {
+	return ((uint64_t)address) >> 48;
+}
+
+/*
+ * Recover generation of segment from given address,
+ * generation is coded by bits 32-47 of the address.
+ */
+static inline uint32_t get_segment_generation(const void* address) {
+	return (((uint64_t)address) >> 32) & SEGMENT_GENERATION_MASK;
+}
+
+/*
+ * Recover offset in segment from given address,
+ * segment offset is coded by the last 32 bits of the addresss.
+ */
+static inline uint64_t get_segment_offset(const void* address) {
+	return ((uint64_t)address) & SEGMENT_OFFSET_MASK;
+}
+
+/*
+ * Recover offset in data of given segment, which address belongs to. It is
+ * get_segment_offset, unless the region is direct-mapped (see direct.h)
+ */
+static inline uint64_t segment_offset(const segment_descriptor_t* desc, const void* address) {
+	return ((uint64_t)address) & desc->offset_mask;
+}
+
+/*
+ * Find the number of accessed field in given segment, alignment is a power
+ * of two so no division is needed
+ */
+static inline size_t find_field_number(const segment_descriptor_t* desc, const void* address) {
+	return (size_t)(segment_offset(desc, address) >> desc->align_shift);
+}
+
+/*
+ * Versioned lock of given field of the segment
+ */
+static inline vlock_t* get_field_lock(const segment_descriptor_t* desc, size_t field) {
+	return &(desc->vlocks[field << desc->lock_shift]);
+}
+
+/*
+ * Get the real address of memory of given virtual address two 
+ * transactional memory 
+ */
+static inline void* get_physical_address(const segment_descriptor_t* desc, const void* address) {
+	return (char*)desc->data + segment_offset(desc, address);
+}
@@ -0,0 +1,63 @@
+#include "arena.h"
+
+static arena_chunk_t* arena_chunk_init(size_t size) {
+    arena_chunk_t* chunk = (arena_chunk_t*)malloc(sizeof(arena_chunk_t) + size);
+    if (!chunk)
+        return NULL;
+    chunk->next = NULL;
+    chunk->size = size;
+    return chunk;
+}
+
+arena_t* arena_init(size_t chunk_size) {
+    arena_t* arena = (arena_t*)malloc(sizeof(arena_t));
+    if (!arena)
+        return NULL;
+    arena->head = arena_chunk_init(chunk_size);
+    if (!arena->head) {
+        free(arena);
+        return NULL;
+    }
+    arena->current = arena->head;
+    arena->used = 0;
+    arena->chunk_size = chunk_size;
+    return arena;
+}
+
+void arena_destroy(arena_t* arena) {
+    arena_chunk_t* chunk = arena->head;
+    while (chunk) {
+        arena_chunk_t* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
+
+/*
+ * Give back all memory taken from the arena, chunks are kept for reuse
+ */
+void arena_reset(arena_t* arena) {
+    arena->current = arena->head;
+    arena->used = 0;
+}
+
+/*
+ * Current chunk is full, move to the next one (allocating it if needed)
+ */
+void* arena_alloc_slow(arena_t* arena, size_t size) {
+    arena_chunk_t* chunk = arena->current;
+    /* Skip kept chunks that are too small for this allocation */
+    while (chunk->next && chunk->next->size < size)
+        chunk = chunk->next;
+
+    if (!chunk->next) {
+        size_t chunk_size = size > arena->chunk_size ? size : arena->chunk_size;
+        chunk->next = arena_chunk_init(chunk_size);
+        if (!chunk->next)
+            return NULL;
+    }
+    arena->current = chunk->next;
+    arena->used = size;
+    return arena->current->data;
+}
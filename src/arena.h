@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#define ARENA_DEFAULT_CHUNK 4096 /* Hyperparameter, bytes in one chunk */
+#define ARENA_ALIGN 8            /* Alignment of every allocation */
+
+struct arena_chunk {
+    struct arena_chunk* next;
+    size_t size;                /* Bytes available in data */
+    char data[];
+};
+typedef struct arena_chunk arena_chunk_t;
+
+/*
+ * Bump allocator, memory is taken from a list of chunks and is given back
+ * all at once with arena_reset. Chunks are kept over resets, so an arena
+ * that is reused does not allocate once it has grown to its working size.
+ */
+struct arena {
+    arena_chunk_t* head;        /* First chunk */
+    arena_chunk_t* current;     /* Chunk allocations are taken from */
+    size_t used;                /* Bytes used in current chunk */
+    size_t chunk_size;          /* Size of newly added chunks */
+};
+typedef struct arena arena_t;
+
+arena_t* arena_init(size_t chunk_size);
+void arena_destroy(arena_t* arena);
+void arena_reset(arena_t* arena);
+void* arena_alloc_slow(arena_t* arena, size_t size);
+
+/*
+ * Allocate size bytes from the arena, NULL if could not allocate
+ */
+static inline void* arena_alloc(arena_t* arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (arena->used + size <= arena->current->size) {
+        void* ptr = arena->current->data + arena->used;
+        arena->used += size;
+        return ptr;
+    }
+    return arena_alloc_slow(arena, size);
+}
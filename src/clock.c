@@ -0,0 +1,86 @@
+#include <stdlib.h>
+
+#include "clock.h"
+#include "thread_ctx.h"
+
+/* GV6 increments the clock for one in GV6_PERIOD commits */
+#define GV6_PERIOD 32
+
+int clock_init(region_t* region, tm_clock_t scheme) {
+    region->clock_scheme = scheme;
+    region->global_clock = 0;
+    region->clock_partitions = NULL;
+    if (scheme == TM_CLOCK_PARTITIONED) {
+        region->clock_partitions = (clock_partition_t*)aligned_alloc(
+            CACHE_LINE_SIZE, CLOCK_PARTITIONS * sizeof(clock_partition_t));
+        if (!region->clock_partitions)
+            return INIT_FAIL;
+        for (size_t i = 0; i < CLOCK_PARTITIONS; ++i)
+            region->clock_partitions[i].value = 0;
+    }
+    return INIT_SUCCESS;
+}
+
+void clock_destroy(region_t* region) {
+    free(region->clock_partitions);
+}
+
+/*
+ * Write version of a commit that locked its write set. Every scheme returns
+ * version bigger then read version of any transaction that started before
+ * the locks were taken, which is all that validation relies on.
+ */
+uint64_t clock_commit(region_t* region, thread_ctx_t* ctx) {
+    switch (region->clock_scheme) {
+    case TM_CLOCK_GV4: {
+        uint64_t clock = atomic_load(&(region->global_clock));
+        if (atomic_compare_exchange_strong(&(region->global_clock), &clock, clock + 1))
+            return clock + 1;
+        return clock; /* Failed CAS loaded timestamp of the winner, share it */
+    }
+    case TM_CLOCK_GV6:
+        if (thread_ctx_random(ctx) % GV6_PERIOD == 0)
+            return atomic_fetch_add(&(region->global_clock), 1) + 1;
+        /* fall through */
+    case TM_CLOCK_GV5:
+        /* Versions may run one ahead of the clock, see clock_catch_up */
+        return atomic_load(&(region->global_clock)) + 1;
+    case TM_CLOCK_PARTITIONED: {
+        uint64_t wv = clock_sample(region) + 1;
+        _Atomic(uint64_t)* own = &(region->clock_partitions[ctx->index % CLOCK_PARTITIONS].value);
+        uint64_t value = atomic_load(own);
+        while (value < wv && !atomic_compare_exchange_weak(own, &value, wv))
+            continue;
+        return wv;
+    }
+    default:
+        return atomic_fetch_add(&(region->global_clock), 1) + 1;
+    }
+}
+
+/*
+ * Transaction with given read version aborted. With GV5 (and GV6) it moves
+ * the clock forward, so later commits get versions newer than what it saw.
+ */
+void clock_abort(region_t* region, uint64_t rv) {
+    if (region->clock_scheme == TM_CLOCK_GV5 || region->clock_scheme == TM_CLOCK_GV6)
+        atomic_compare_exchange_strong(&(region->global_clock), &rv, rv + 1);
+}
+
+/*
+ * Field with given version was read. With GV5 (and GV6) versions run one
+ * ahead of the clock, and no snapshot could include the field until a
+ * commit moves the clock, so readers move it up to the version themselves.
+ * Every commit with version up to it took its version after locking, so
+ * before this, which keeps extension sound, see tl2_extend.
+ *
+ * Returns the clock, at least version
+ */
+uint64_t clock_catch_up(region_t* region, uint64_t version) {
+    if (region->clock_scheme != TM_CLOCK_GV5 && region->clock_scheme != TM_CLOCK_GV6)
+        return clock_sample(region); /* Versions never run ahead of the clock */
+    uint64_t clock = atomic_load(&(region->global_clock));
+    while (clock < version && !atomic_compare_exchange_weak(&(region->global_clock), &clock, version))
+        continue;
+    return clock < version ? version : clock;
+}
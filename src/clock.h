@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include <tm_ext.h>
+
+#include "macros.h"
+#include "structs.h"
+
+#define CLOCK_PARTITIONS 16 /* Hyperparameter, partitions of TM_CLOCK_PARTITIONED */
+
+/* One partition of the clock, alone in its cache line */
+struct clock_partition {
+    _Alignas(CACHE_LINE_SIZE) _Atomic(uint64_t) value;
+};
+typedef struct clock_partition clock_partition_t;
+
+int clock_init(region_t* region, tm_clock_t scheme);
+void clock_destroy(region_t* region);
+uint64_t clock_commit(region_t* region, thread_ctx_t* ctx);
+void clock_abort(region_t* region, uint64_t rv);
+uint64_t clock_catch_up(region_t* region, uint64_t version);
+
+/*
+ * Sample the clock at the beginning of a transaction (its read version)
+ */
+static inline uint64_t clock_sample(region_t* region) {
+    if (likely(region->clock_scheme != TM_CLOCK_PARTITIONED))
+        return atomic_load(&(region->global_clock));
+
+    uint64_t max = 0;
+    for (size_t i = 0; i < CLOCK_PARTITIONS; ++i) {
+        uint64_t value = atomic_load(&(region->clock_partitions[i].value));
+        max = value > max ? value : max;
+    }
+    return max;
+}
@@ -0,0 +1,74 @@
+#include "cm.h"
+
+/*
+ * Count of the thread, only the owner writes it, so no read-modify-write
+ */
+static inline void cm_count(_Atomic(uint64_t)* counter) {
+    uint64_t value = atomic_load_explicit(counter, memory_order_relaxed);
+    atomic_store_explicit(counter, value + 1, memory_order_relaxed);
+}
+
+/*
+ * Called before every attempt of tm_atomic
+ */
+void cm_on_begin(thread_ctx_t* ctx, tm_cm_t cm) {
+    uint64_t priority = cm_priority(ctx);
+    if (cm != TM_CM_KARMA)
+        priority = 0;
+    else if (priority == 0)
+        priority = 1;
+    atomic_store_explicit(&(ctx->cm_priority), priority, memory_order_relaxed);
+}
+
+/*
+ * Called after an attempt of tm_atomic aborted, before the next one
+ */
+void cm_on_abort(thread_ctx_t* ctx, tm_cm_t cm, size_t attempt) {
+    cm_count(&(ctx->cm_aborts[cm]));
+    if (cm == TM_CM_KARMA) {
+        /* Work lost in aborted attempts is what Karma rewards */
+        cm_count(&(ctx->cm_priority));
+    }
+    else if (cm == TM_CM_BACKOFF) {
+        size_t shift = CM_BACKOFF_MIN + attempt;
+        if (shift > CM_BACKOFF_MAX)
+            shift = CM_BACKOFF_MAX;
+        uint64_t spins = thread_ctx_random(ctx) & ((UINT64_C(1) << shift) - 1);
+        for (uint64_t i = 0; i < spins; ++i)
+            cpu_relax();
+    }
+}
+
+/*
+ * Called after an attempt of tm_atomic commited
+ */
+void cm_on_commit(thread_ctx_t* ctx, tm_cm_t cm) {
+    cm_count(&(ctx->cm_commits[cm]));
+    atomic_store_explicit(&(ctx->cm_priority), 0, memory_order_relaxed);
+}
+
+/*
+ * Lock with given word is held by another transaction. Under Karma, wait
+ * until it is released if the owner has lower priority, ties are broken by
+ * address of the context. Contexts are freed only with the region, so the
+ * owner can be read even after it released the lock.
+ *
+ * True if the lock was released, its free word is stored to word
+ */
+bool cm_wait_lock(thread_ctx_t* ctx, vlock_t* lock, uint64_t* word) {
+    uint64_t priority = cm_priority(ctx);
+    if (likely(priority == 0))
+        return false;
+
+    for (size_t spins = 0; spins < CM_KARMA_SPINS; ++spins) {
+        thread_ctx_t* owner = (thread_ctx_t*)(*word & ~(uint64_t)VLOCK_LOCKED);
+        uint64_t owner_priority = cm_priority(owner);
+        if (owner_priority > priority || (owner_priority == priority && owner < ctx))
+            return false; /* Owner is worth more, give up */
+        cpu_relax();
+        *word = vlock_sample(lock);
+        if (!vlock_is_locked(*word))
+            return true;
+    }
+    return false;
+}
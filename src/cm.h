@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <tm_ext.h>
+
+#include "structs.h"
+#include "thread_ctx.h"
+
+/*
+ * Contention management of transactions run by tm_atomic. Aborted
+ * transaction either retries immediately, after randomized exponential
+ * backoff, or under Karma, where priority of the thread (aborts since its
+ * last commit) lets it wait for locks held by threads with lower priority
+ * at commit time instead of aborting.
+ */
+
+#define CM_BACKOFF_MIN 4    /* Hyperparameter, log2 of spins after the first abort */
+#define CM_BACKOFF_MAX 16   /* Hyperparameter, log2 of maximum spins */
+#define CM_KARMA_SPINS 1024 /* Hyperparameter, spins waiting for one lock */
+
+void cm_on_begin(thread_ctx_t* ctx, tm_cm_t cm);
+void cm_on_abort(thread_ctx_t* ctx, tm_cm_t cm, size_t attempt);
+void cm_on_commit(thread_ctx_t* ctx, tm_cm_t cm);
+bool cm_wait_lock(thread_ctx_t* ctx, vlock_t* lock, uint64_t* word);
+
+/*
+ * Priority of the thread in Karma, 0 when it does not run under Karma
+ */
+static inline uint64_t cm_priority(thread_ctx_t* ctx) {
+    return atomic_load_explicit(&(ctx->cm_priority), memory_order_relaxed);
+}
@@ -0,0 +1,164 @@
+// Requested feature: MAP_ANONYMOUS, MAP_NORESERVE, madvise
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "direct.h"
+#include "addressing.h"
+#include "segment_pool.h"
+#include "engine.h"
+
+/*
+ * Descriptor spanning the address space, with the reservations backing it
+ */
+typedef struct direct_space {
+    segment_descriptor_t desc;  /* Must be first, region->direct points to it */
+    void* data_mapping;
+    size_t data_length;
+    void* locks_mapping;        /* NULL if engine has no field locks */
+    size_t locks_length;
+} direct_space_t;
+
+/*
+ * Segments start at multiples of this, so that their data is aligned
+ */
+static size_t direct_granule(size_t align) {
+    return align > CACHE_LINE_SIZE ? align : CACHE_LINE_SIZE;
+}
+
+static void* direct_reserve(size_t length) {
+    void* mapping = mmap(NULL, length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return mapping == MAP_FAILED ? NULL : mapping;
+}
+
+/*
+ * Make pages covering given range accessible, pages on its ends may be shared
+ * with neighbouring segments, which is harmless as protection only ever grows
+ */
+static bool direct_commit(void* start, size_t length) {
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t first = (uintptr_t)start & ~(page - 1);
+    uintptr_t last = ((uintptr_t)start + length + page - 1) & ~(page - 1);
+    return mprotect((void*)first, last - first, PROT_READ | PROT_WRITE) == 0;
+}
+
+/*
+ * Give back memory of pages that are whole inside given range, they read as
+ * zeros when touched again
+ */
+static void direct_decommit(void* start, size_t length) {
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t first = ((uintptr_t)start + page - 1) & ~(page - 1);
+    uintptr_t last = ((uintptr_t)start + length) & ~(page - 1);
+    if (first < last)
+        madvise((void*)first, last - first, MADV_DONTNEED);
+}
+
+int direct_init(region_t* region) {
+    size_t align = region->align;
+    size_t granule = direct_granule(align);
+    direct_space_t* space = (direct_space_t*)malloc(sizeof(direct_space_t));
+    if (!space)
+        return INIT_FAIL;
+
+    /* Page aligned reservation, granule may be bigger than a page */
+    space->data_length = DIRECT_SPACE_SIZE + granule;
+    space->data_mapping = direct_reserve(space->data_length);
+    if (!space->data_mapping) {
+        free(space);
+        return INIT_FAIL;
+    }
+    space->locks_mapping = NULL;
+    space->locks_length = 0;
+    if (region->engine->field_locks) {
+        space->locks_length = ((DIRECT_SPACE_SIZE / align) << region->lock_shift) * sizeof(vlock_t);
+        space->locks_mapping = direct_reserve(space->locks_length);
+        if (!space->locks_mapping) {
+            munmap(space->data_mapping, space->data_length);
+            free(space);
+            return INIT_FAIL;
+        }
+    }
+
+    segment_descriptor_t* desc = &(space->desc);
+    uintptr_t data = ((uintptr_t)space->data_mapping + granule - 1) & ~(uintptr_t)(granule - 1);
+    desc->data = (void*)data;
+    desc->vlocks = (vlock_t*)space->locks_mapping;
+    desc->lock_shift = region->lock_shift;
+    desc->versions = NULL;
+    desc->size = DIRECT_SPACE_SIZE;
+    desc->capacity = DIRECT_SPACE_SIZE;
+    desc->size_class = SEGMENT_POOL_CLASSES;
+    desc->align = align;
+    desc->align_shift = (size_t)__builtin_ctzl(align);
+    desc->offset_mask = UINT64_MAX; /* Whole address is the offset */
+    desc->fields = DIRECT_SPACE_SIZE / align;
+    desc->num = DEFAULT_SEGMENT_NUM;
+    desc->generation = 0;
+    desc->next_free = NULL;
+    region->direct = desc;
+    return INIT_SUCCESS;
+}
+
+void direct_destroy(region_t* region) {
+    direct_space_t* space = (direct_space_t*)region->direct;
+    munmap(space->data_mapping, space->data_length);
+    if (space->locks_mapping)
+        munmap(space->locks_mapping, space->locks_length);
+    free(space);
+    region->direct = NULL;
+}
+
+segment_descriptor_t* direct_segment_alloc(region_t* region, size_t size) {
+    segment_descriptor_t* space = region->direct;
+    size_t align = region->align;
+    size_t granule = direct_granule(align);
+    size_t header = direct_header_size(align);
+    size_t capacity = segment_pool_capacity(size, align);
+    size_t length = (header + capacity + granule - 1) / granule * granule;
+
+    uint64_t start = atomic_fetch_add(&(region->direct_next), length);
+    if (start + length > DIRECT_SPACE_SIZE)
+        return NULL; /* Address space is exhausted */
+    char* chunk = (char*)space->data + start;
+    if (!direct_commit(chunk, length))
+        return NULL;
+    /* Lengths are multiples of the alignment, so are offsets */
+    vlock_t* locks = space->vlocks ? get_field_lock(space, start >> space->align_shift) : NULL;
+    if (locks && !direct_commit(locks, ((length >> space->align_shift) << space->lock_shift) * sizeof(vlock_t)))
+        return NULL;
+
+    /* Fresh pages are zeroed, data and locks need no initialization */
+    segment_descriptor_t* desc = (segment_descriptor_t*)chunk;
+    desc->data = chunk + header;
+    desc->vlocks = locks ? get_field_lock(space, (start + header) >> space->align_shift) : NULL;
+    desc->lock_shift = space->lock_shift;
+    desc->versions = NULL;
+    desc->size = size;
+    desc->capacity = capacity;
+    desc->size_class = segment_pool_class(size);
+    desc->align = align;
+    desc->align_shift = space->align_shift;
+    desc->offset_mask = 0;      /* Addresses are translated by region->direct */
+    desc->fields = size / align;
+    desc->num = DEFAULT_SEGMENT_NUM; /* Not in the segment directory */
+    desc->generation = 0;
+    desc->next_free = NULL;
+    return desc;
+}
+
+void direct_segment_release(region_t* region, segment_descriptor_t* desc) {
+    segment_descriptor_t* space = region->direct;
+    size_t header = direct_header_size(region->align);
+    char* chunk = (char*)desc->data - header;
+    size_t length = header + desc->capacity;
+    if (desc->vlocks) {
+        size_t locks = (length >> space->align_shift) << space->lock_shift;
+        direct_decommit(desc->vlocks - ((header >> space->align_shift) << space->lock_shift),
+                        locks * sizeof(vlock_t));
+    }
+    /* Descriptor is in the decommited range, it is not touched after */
+    direct_decommit(chunk, length);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "structs.h"
+
+#define DIRECT_SPACE_SIZE (1ull << 35)  /* Hyperparameter, bytes of address space reserved for data of a region */
+
+/*
+ * Direct-mapped address space of a region (tm_config_t.direct_mapped).
+ *
+ * Region reserves DIRECT_SPACE_SIZE bytes of address space for data with
+ * mmap(PROT_NONE), and a parallel range for versioned locks of its fields.
+ * Segments are carved from the reservation by bumping an offset and made
+ * accessible with mprotect. Virtual address of a byte is its offset from the
+ * start of the reservation, so data of address a is at base + a and its lock
+ * at locks + (a >> align_shift), for every segment.
+ *
+ * region->direct is a descriptor spanning the whole reservation, which
+ * find_segment returns for every address, so engines translate addresses
+ * with plain arithmetic. Descriptor of each allocated segment lives in a
+ * header right before its data (see direct_segment_of), it is only needed
+ * to allocate and free the segment.
+ *
+ * Segments freed to the size class pools are reused as usual, memory of
+ * other freed segments is given back to the system but their address range
+ * is never handed out again.
+ */
+
+/*
+ * Reserve address space of the region, engine and alignment must be set
+ */
+int direct_init(region_t* region);
+
+/*
+ * Unmap all memory of the region, including descriptors of its segments
+ */
+void direct_destroy(region_t* region);
+
+/*
+ * Carve new segment of given size from the address space
+ *
+ * NULL if the address space is exhausted or could not be made accessible
+ */
+segment_descriptor_t* direct_segment_alloc(region_t* region, size_t size);
+
+/*
+ * Give back memory of segment no transaction can access, its descriptor is
+ * gone after the call
+ */
+void direct_segment_release(region_t* region, segment_descriptor_t* desc);
+
+/*
+ * Bytes between the start of a segment's header and its data
+ */
+static inline size_t direct_header_size(size_t align) {
+    size_t granule = align > CACHE_LINE_SIZE ? align : CACHE_LINE_SIZE;
+    return (sizeof(segment_descriptor_t) + granule - 1) / granule * granule;
+}
+
+/*
+ * Descriptor of the segment that starts at given virtual address
+ */
+static inline segment_descriptor_t* direct_segment_of(const region_t* region, const void* address) {
+    char* data = (char*)region->direct->data + (uintptr_t)address;
+    return (segment_descriptor_t*)(data - direct_header_size(region->align));
+}
+
+/*
+ * Virtual address of the first byte of given segment
+ */
+static inline void* direct_address(const region_t* region, const segment_descriptor_t* desc) {
+    return (void*)((char*)desc->data - (char*)region->direct->data);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <tm_ext.h>
+
+#include "structs.h"
+
+/*
+ * Engine of a region, the algorithm that runs its transactions. Entry points
+ * of tm.c resolve the segment, dispatch to the engine and abort (or commit)
+ * the transaction depending on the result, so engines only implement the
+ * algorithm itself.
+ */
+struct engine {
+    /* Sample the snapshot of transaction that was just reset by transaction_begin */
+    void (*begin)(transaction_t* tx);
+    /* Read size bytes (multiple of alignment) from source in segment, false to abort */
+    bool (*read)(transaction_t* tx, segment_descriptor_t* segment, const void* source, size_t size, void* target);
+    /* Write size bytes (multiple of alignment) to target in segment, false to abort */
+    bool (*write)(transaction_t* tx, segment_descriptor_t* segment, const void* source, size_t size, void* target);
+    /* Try to commit, false to abort */
+    bool (*end)(transaction_t* tx);
+    /* Undo effects of transaction which aborts, NULL if it has none */
+    void (*abort)(transaction_t* tx);
+    bool field_locks;           /* Whether segments need versioned locks of fields */
+    bool value_log;             /* Whether transactions need a log of read values */
+};
+typedef struct engine engine_t;
+
+extern const engine_t tl2_engine;
+extern const engine_t tl2_engine_8;    /* TL2 specialized for 8 byte alignment */
+extern const engine_t norec_engine;
+extern const engine_t etl_engine;
+
+/*
+ * Engine implementing given choice of the configuration, specialized for
+ * alignment of the region if there is such instance
+ */
+static inline const engine_t* engine_get(tm_engine_t engine, size_t align) {
+    switch (engine) {
+    case TM_ENGINE_NOREC:
+        return &norec_engine;
+    case TM_ENGINE_ETL:
+        return &etl_engine;
+    default:
+        return align == 8 ? &tl2_engine_8 : &tl2_engine;
+    }
+}
@@ -0,0 +1,132 @@
+#include <stdlib.h>
+
+#include "epoch.h"
+#include "segment_pool.h"
+#include "mvcc.h"
+
+int epoch_ctx_init(thread_ctx_t* ctx) {
+    atomic_init(&(ctx->epoch), 0);
+    ctx->limbo_size = 0;
+    for (size_t i = 0; i < EPOCH_LISTS; ++i) {
+        ctx->limbo_epoch[i] = 0;
+        ctx->limbo[i] = vector_init(VECTOR_DEFAULT_SIZE);
+        ctx->mv_limbo[i] = vector_init(VECTOR_DEFAULT_SIZE);
+        if (!ctx->limbo[i] || !ctx->mv_limbo[i]) {
+            if (ctx->limbo[i])
+                vector_destroy(ctx->limbo[i]);
+            if (ctx->mv_limbo[i])
+                vector_destroy(ctx->mv_limbo[i]);
+            while (i-- > 0) {
+                vector_destroy(ctx->limbo[i]);
+                vector_destroy(ctx->mv_limbo[i]);
+            }
+            return INIT_FAIL;
+        }
+    }
+    return INIT_SUCCESS;
+}
+
+/*
+ * Segments still in limbo are in the segment directory as well, they are
+ * destroyed with the region. Old versions are only here.
+ */
+void epoch_ctx_destroy(thread_ctx_t* ctx) {
+    for (size_t i = 0; i < EPOCH_LISTS; ++i) {
+        vector_destroy(ctx->limbo[i]);
+        for (size_t j = 0; j < ctx->mv_limbo[i]->size; ++j)
+            mv_reclaim(ctx, ctx->mv_limbo[i]->data[j]);
+        vector_destroy(ctx->mv_limbo[i]);
+    }
+}
+
+/*
+ * Try to move the global epoch one forward
+ */
+static void epoch_try_advance(region_t* region) {
+    uint64_t epoch = atomic_load(&(region->epoch));
+    atomic_thread_fence(memory_order_seq_cst);
+    for (thread_ctx_t* ctx = atomic_load(&(region->threads)); ctx; ctx = ctx->next) {
+        uint64_t announced = atomic_load_explicit(&(ctx->epoch), memory_order_relaxed);
+        if ((announced & EPOCH_ACTIVE) && (announced >> 1) != epoch)
+            return; /* Thread in older epoch is still running */
+    }
+    atomic_compare_exchange_strong(&(region->epoch), &epoch, epoch + 1);
+}
+
+/*
+ * Give back segments and old versions of the limbo lists with given index
+ */
+static void epoch_reclaim_list(region_t* region, thread_ctx_t* ctx, size_t index) {
+    vector_t* list = ctx->limbo[index];
+    for (size_t i = 0; i < list->size; ++i)
+        segment_pool_free(region, ctx, list->data[i]);
+    ctx->limbo_size -= list->size;
+    list->size = 0;
+
+    list = ctx->mv_limbo[index];
+    for (size_t i = 0; i < list->size; ++i)
+        mv_reclaim(ctx, list->data[i]);
+    ctx->limbo_size -= list->size;
+    list->size = 0;
+}
+
+/*
+ * Give back all segments and old versions of the thread which are two epochs old
+ */
+static void epoch_reclaim(region_t* region, thread_ctx_t* ctx) {
+    uint64_t epoch = atomic_load(&(region->epoch));
+    for (size_t i = 0; i < EPOCH_LISTS; ++i) {
+        if (ctx->limbo[i]->size + ctx->mv_limbo[i]->size > 0 && ctx->limbo_epoch[i] + 2 <= epoch)
+            epoch_reclaim_list(region, ctx, i);
+    }
+}
+
+/*
+ * Index of limbo lists for things retired now
+ */
+static size_t epoch_limbo(region_t* region, thread_ctx_t* ctx) {
+    uint64_t epoch = atomic_load(&(region->epoch));
+    size_t index = epoch % EPOCH_LISTS;
+    if (ctx->limbo_epoch[index] != epoch) {
+        /* Lists hold things at least EPOCH_LISTS epochs old */
+        epoch_reclaim_list(region, ctx, index);
+        ctx->limbo_epoch[index] = epoch;
+    }
+    return index;
+}
+
+/*
+ * Something was put in limbo, reclaim if there is enough of it
+ */
+static void epoch_retired(region_t* region, thread_ctx_t* ctx) {
+    ctx->limbo_size++;
+    if (ctx->limbo_size >= EPOCH_RECLAIM_THRESHOLD) {
+        epoch_try_advance(region);
+        epoch_reclaim(region, ctx);
+    }
+}
+
+/*
+ * Segment was freed by a transaction that just commited, so new transactions
+ * cannot reach it. Put it in limbo until transactions which could, end.
+ */
+void epoch_retire(region_t* region, thread_ctx_t* ctx, segment_descriptor_t* desc) {
+    size_t index = epoch_limbo(region, ctx);
+    if (!vector_push_back(ctx->limbo[index], desc)) {
+        /* Segment stays in the directory, it is destroyed with the region */
+        return;
+    }
+    epoch_retired(region, ctx);
+}
+
+/*
+ * List of old versions was cut off a chain, readers may still walk it
+ */
+void epoch_retire_versions(region_t* region, thread_ctx_t* ctx, struct mv_node* versions) {
+    size_t index = epoch_limbo(region, ctx);
+    if (!vector_push_back(ctx->mv_limbo[index], versions)) {
+        /* Leaked rather than freed under a reader */
+        return;
+    }
+    epoch_retired(region, ctx);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "structs.h"
+#include "thread_ctx.h"
+
+/*
+ * Epoch based reclamation of freed segments. Every thread announces the
+ * global epoch it observed when it begins a transaction and clears the
+ * announcement when the transaction ends. Segments freed by commited
+ * transactions go to limbo lists of the freeing thread, tagged with the
+ * epoch of the commit, and so do old versions cut off by commits (see
+ * mvcc.h). Epoch can advance only when every active thread announced the
+ * current one, so once it moved two epochs past the tag, no transaction
+ * that could have seen the segment is running.
+ */
+
+#define EPOCH_ACTIVE 1              /* Bit of announcement of a running transaction */
+#define EPOCH_RECLAIM_THRESHOLD 16  /* Hyperparameter, retired segments before trying to reclaim */
+
+int epoch_ctx_init(thread_ctx_t* ctx);
+void epoch_ctx_destroy(thread_ctx_t* ctx);
+void epoch_retire(region_t* region, thread_ctx_t* ctx, segment_descriptor_t* desc);
+void epoch_retire_versions(region_t* region, thread_ctx_t* ctx, struct mv_node* versions);
+
+/*
+ * Announce that the thread starts a transaction, before it reads anything
+ */
+static inline void epoch_enter(region_t* region, thread_ctx_t* ctx) {
+    uint64_t epoch = atomic_load_explicit(&(region->epoch), memory_order_relaxed);
+    atomic_store_explicit(&(ctx->epoch), (epoch << 1) | EPOCH_ACTIVE, memory_order_relaxed);
+    /* Announcement has to be visible before the first read of the transaction */
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+/*
+ * Announce that the thread ended its transaction (commited or aborted)
+ */
+static inline void epoch_exit(thread_ctx_t* ctx) {
+    atomic_store_explicit(&(ctx->epoch), 0, memory_order_release);
+}
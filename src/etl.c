@@ -0,0 +1,167 @@
+#include <string.h>
+
+#include "engine.h"
+#include "tl2.h"
+#include "addressing.h"
+#include "clock.h"
+#include "stats.h"
+#include "profile.h"
+
+/*
+ * Encounter-time locking, write-through engine (TinySTM style). It shares
+ * the versioned locks and the read set with TL2, but a write locks its
+ * field right away and writes in place. The write set serves as undo log:
+ * its entries hold the old values and the versions the fields had before
+ * they were locked. Reads of own writes find the field locked by the
+ * transaction itself and read it in place, commit only validates reads and
+ * releases locks, and abort writes the old values back (under a new
+ * version).
+ */
+
+static void etl_begin(transaction_t* tx) {
+    tx->rv = clock_sample(tx->region);
+}
+
+/*
+ * Read one field, like tl2_load but fields locked by tx hold its own writes
+ */
+static bool etl_load(transaction_t* tx, segment_descriptor_t* segment, const void* source, void* buffer) {
+    size_t align = segment->align;
+    vlock_t* lock = get_field_lock(segment, find_field_number(segment, source));
+    const void* data = get_physical_address(segment, source);
+    uint64_t word;
+    for (size_t attempt = 0;; ++attempt) {
+        word = vlock_sample(lock);
+        memcpy(buffer, data, align);
+        if (word == vlock_owned_word(tx->ctx))
+            return true; /* Own write, nothing to validate */
+        if (vlock_is_locked(word) || vlock_resample(lock) != word) {
+            profile_conflict(tx, source);
+            return stats_abort(tx, TM_ABORT_LOCKED); /* Field is being written, abort */
+        }
+        if (vlock_version(word) <= tx->rv)
+            break;
+        /* Field is newer than the snapshot, try to move the snapshot past it */
+        const void* conflict = source; /* Unless a field read before changed */
+        if (attempt == TL2_EXTEND_ATTEMPTS || !tl2_extend(tx, vlock_version(word), &conflict)) {
+            profile_conflict(tx, conflict);
+            return stats_abort(tx, TM_ABORT_SNAPSHOT); /* Read value from older snapshot, abort */
+        }
+    }
+
+    if (!read_set_push(tx->read_set, lock, source, vlock_version(word)))
+        return stats_abort(tx, TM_ABORT_VALIDATION); /* Read stale before (or could not add to read_set), abort */
+    return true;
+}
+
+/*
+ * Write one field in place, locking it and saving its old value first
+ */
+static bool etl_store(transaction_t* tx, segment_descriptor_t* segment, const void* source, void* target) {
+    size_t align = segment->align;
+    vlock_t* lock = get_field_lock(segment, find_field_number(segment, target));
+    void* data = get_physical_address(segment, target);
+    uint64_t word = vlock_sample(lock);
+
+    if (word != vlock_owned_word(tx->ctx)) {
+        /* Other writer is waited for only shortly, as it may wait for us */
+        if ((vlock_is_locked(word) && !vlock_wait(lock, &word, TL2_LOCK_SPINS_MIN)) ||
+            !vlock_try_lock(lock, word, tx->ctx)) {
+            /* Lock is locked, or another writer took it first, abort */
+            profile_conflict(tx, target);
+            return stats_abort(tx, TM_ABORT_LOCK);
+        }
+
+        /* Entry is added only once the lock is held, so abort can undo every
+           entry */
+        bool inserted;
+        write_entry_t* entry = write_set_insert(tx->write_set, target, &inserted);
+        void* value = entry ? arena_alloc(tx->write_values, align) : NULL;
+        if (!value) {
+            if (entry)
+                write_set_drop_last(tx->write_set); /* Drop the half built entry, it is the last one */
+            vlock_unlock(lock, vlock_version(word));
+            return stats_abort(tx, TM_ABORT_NOMEM); /* Could not allocate, abort */
+        }
+        memcpy(value, data, align);
+        entry->value = value;
+        entry->data = data;
+        entry->lock = lock;
+        entry->version = vlock_version(word);
+        entry->chain = NULL;
+    }
+    memcpy(data, source, align);
+    return true;
+}
+
+static bool etl_read(transaction_t* tx, segment_descriptor_t* segment, const void* source, size_t size, void* target) {
+    if (tx->is_ro)
+        return tl2_read_ro(tx, segment, source, size, target);
+
+    size_t align = segment->align;
+    for (size_t offset = 0; offset < size; offset += align) {
+        if (!etl_load(tx, segment, (const char*)source + offset, (char*)target + offset))
+            return false;
+    }
+    return true;
+}
+
+static bool etl_write(transaction_t* tx, segment_descriptor_t* segment, const void* source, size_t size, void* target) {
+    size_t align = segment->align;
+    for (size_t offset = 0; offset < size; offset += align) {
+        if (!etl_store(tx, segment, (const char*)source + offset, (char*)target + offset))
+            return false;
+    }
+    return true;
+}
+
+static bool etl_end(transaction_t* tx) {
+    write_set_t* write_set = tx->write_set;
+    if (tx->is_ro || write_set->size == 0) {
+        /* Every read was consistent at rv */
+        return true;
+    }
+
+    uint64_t wv = clock_commit(tx->region, tx->ctx);
+    const void* conflict;
+    if (!tl2_validate(tx, &conflict)) {
+        profile_conflict(tx, conflict);
+        return stats_abort(tx, TM_ABORT_VALIDATION); /* Read value no longer valid, etl_abort undoes writes */
+    }
+
+    /* New values are in place, publish them with new version */
+    for (size_t i = 0; i < write_set->size; ++i)
+        vlock_unlock(write_set->entries[i].lock, wv);
+    return true;
+}
+
+/*
+ * Write old values back and release locks with a new version. A reader may
+ * have sampled the old version before the lock was taken and copied the
+ * value written in place, so the old version must not come back: it would
+ * find it again and accept the value. New version is bigger than the read
+ * version of any such reader, see clock_commit.
+ */
+static void etl_abort(transaction_t* tx) {
+    write_set_t* write_set = tx->write_set;
+    if (tx->is_ro || write_set->size == 0)
+        return;
+    uint64_t version = clock_commit(tx->region, tx->ctx);
+    for (size_t i = 0; i < write_set->size; ++i) {
+        write_entry_t* entry = &(write_set->entries[i]);
+        memcpy(entry->data, entry->value, tx->region->align);
+        vlock_unlock(entry->lock, version);
+    }
+    /* Entries are not undone twice, in case the descriptor ends again */
+    write_set_clear(write_set);
+}
+
+const engine_t etl_engine = {
+    .begin = etl_begin,
+    .read = etl_read,
+    .write = etl_write,
+    .end = etl_end,
+    .abort = etl_abort,
+    .field_locks = true,
+    .value_log = false,
+};
@@ -34,3 +34,29 @@
     #define unused(variable)
     #warning This compiler has no support for GCC attributes
 #endif
+
+/** Whether statistics of transactions are collected (see stats.h), set by
+ * the build, compiled out otherwise.
+**/
+#ifndef TM_STATS
+    #define TM_STATS 0
+#endif
+
+/** Size of cache line, for padding shared variables.
+**/
+#undef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+
+/** Hint to the processor that we are spinning.
+**/
+#undef cpu_relax
+#if defined(__x86_64__) || defined(__i386__)
+    #define cpu_relax() \
+        __builtin_ia32_pause()
+#elif defined(__aarch64__)
+    #define cpu_relax() \
+        __asm__ __volatile__("yield" ::: "memory")
+#else
+    #define cpu_relax() \
+        __asm__ __volatile__("" ::: "memory")
+#endif
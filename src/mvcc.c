@@ -0,0 +1,270 @@
+// Requested feature: sched_yield
+#define _POSIX_C_SOURCE   200809L
+
+#include <sched.h>
+#include <string.h>
+
+#include "mvcc.h"
+#include "addressing.h"
+#include "clock.h"
+#include "epoch.h"
+
+/*
+ * Change count of versions of the thread, only the owner writes it. Versions
+ * pushed by one thread may be reclaimed by another, so counts of single
+ * threads wrap around, only their sum is meaningful.
+ */
+static inline void mv_count(thread_ctx_t* ctx, uint64_t delta) {
+    uint64_t value = atomic_load_explicit(&(ctx->mv_versions), memory_order_relaxed);
+    atomic_store_explicit(&(ctx->mv_versions), value + delta, memory_order_relaxed);
+}
+
+static inline size_t mv_node_size(size_t align) {
+    return sizeof(mv_node_t) + align;
+}
+
+/*
+ * Free node from the cache of the thread, NULL if could not allocate
+ */
+static mv_node_t* mv_node_alloc(thread_ctx_t* ctx, size_t align) {
+    mv_node_t* node = ctx->mv_free;
+    if (likely(node)) {
+        ctx->mv_free = atomic_load_explicit(&(node->older), memory_order_relaxed);
+        ctx->mv_free_count--;
+        return node;
+    }
+    return (mv_node_t*)malloc(mv_node_size(align));
+}
+
+static void mv_node_free(thread_ctx_t* ctx, mv_node_t* node) {
+    if (ctx->mv_free_count >= MV_CACHE_DEPTH) {
+        free(node);
+        return;
+    }
+    atomic_store_explicit(&(node->older), ctx->mv_free, memory_order_relaxed);
+    ctx->mv_free = node;
+    ctx->mv_free_count++;
+}
+
+/*
+ * Chains of all fields of the segment, only in multi-version regions
+ */
+int mv_segment_init(region_t* region, segment_descriptor_t* desc) {
+    desc->versions = NULL;
+    if (!region->multi_version)
+        return INIT_SUCCESS;
+    desc->versions = (_Atomic(mv_node_t*)*)calloc(desc->capacity / desc->align, sizeof(mv_node_t*));
+    if (!desc->versions)
+        return INIT_FAIL;
+    return INIT_SUCCESS;
+}
+
+/*
+ * Give back all versions of the segment no running transaction can access
+ */
+void mv_segment_clear(thread_ctx_t* ctx, segment_descriptor_t* desc) {
+    if (!desc->versions)
+        return;
+    for (size_t i = 0; i < desc->capacity / desc->align; ++i) {
+        mv_node_t* chain = atomic_load_explicit(&(desc->versions[i]), memory_order_relaxed);
+        if (chain) {
+            mv_reclaim(ctx, chain);
+            atomic_store_explicit(&(desc->versions[i]), NULL, memory_order_relaxed);
+        }
+    }
+}
+
+void mv_segment_destroy(segment_descriptor_t* desc) {
+    if (!desc->versions)
+        return;
+    for (size_t i = 0; i < desc->capacity / desc->align; ++i) {
+        mv_node_t* node = atomic_load_explicit(&(desc->versions[i]), memory_order_relaxed);
+        while (node) {
+            mv_node_t* older = atomic_load_explicit(&(node->older), memory_order_relaxed);
+            free(node);
+            node = older;
+        }
+    }
+    free(desc->versions);
+}
+
+/*
+ * Free nodes cached by the thread
+ */
+void mv_ctx_destroy(thread_ctx_t* ctx) {
+    mv_node_t* node = ctx->mv_free;
+    while (node) {
+        mv_node_t* next = atomic_load_explicit(&(node->older), memory_order_relaxed);
+        free(node);
+        node = next;
+    }
+    ctx->mv_free = NULL;
+    ctx->mv_free_count = 0;
+}
+
+/*
+ * Announce snapshot of read-only transaction which begins, returns its read
+ * version. Until the version is announced, 0 keeps commits from cutting any
+ * chain. Read version is sampled after that is visible, so a horizon
+ * computed without seeing the announcement is not newer than it.
+ */
+uint64_t mv_snapshot_begin(region_t* region, thread_ctx_t* ctx) {
+    atomic_store_explicit(&(ctx->mv_snapshot), 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    uint64_t rv = clock_sample(region);
+    atomic_store_explicit(&(ctx->mv_snapshot), rv, memory_order_relaxed);
+    return rv;
+}
+
+/*
+ * Oldest snapshot any read-only transaction running now or later can have
+ */
+static uint64_t mv_horizon(region_t* region) {
+    uint64_t horizon = clock_sample(region);
+    atomic_thread_fence(memory_order_seq_cst);
+    for (thread_ctx_t* ctx = atomic_load(&(region->threads)); ctx; ctx = ctx->next) {
+        uint64_t snapshot = atomic_load_explicit(&(ctx->mv_snapshot), memory_order_relaxed);
+        horizon = snapshot < horizon ? snapshot : horizon;
+    }
+    return horizon;
+}
+
+/*
+ * Read one field as it was at version rv. False only if the chain lost the
+ * value, which the horizon rules out.
+ */
+static bool mv_read_field(uint64_t rv, vlock_t* lock, _Atomic(mv_node_t*)* chain, 
+                          const void* data, void* target, size_t align) {
+    for (;;) {
+        uint64_t word = vlock_sample(lock);
+        if (vlock_is_locked(word)) {
+            /* Overwritten value gets to the chain only at write back, wait
+               for the commit (or abort) to finish */
+            if (!vlock_wait(lock, &word, MV_WAIT_SPINS))
+                sched_yield();
+            continue;
+        }
+        if (vlock_version(word) <= rv) {
+            memcpy(target, data, align);
+            if (vlock_resample(lock) == word)
+                return true;
+            continue; /* Field was written meanwhile, it is in the chain now */
+        }
+
+        /* Field is newer than the snapshot, take the value it had then */
+        mv_node_t* node = atomic_load_explicit(chain, memory_order_acquire);
+        for (; node; node = atomic_load_explicit(&(node->older), memory_order_acquire)) {
+            if (node->version <= rv) {
+                memcpy(target, node->value, align);
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+bool mv_read(transaction_t* tx, segment_descriptor_t* segment, const void* source, size_t size, void* target) {
+    size_t align = segment->align;
+    size_t first = find_field_number(segment, source);
+    const char* data = get_physical_address(segment, source);
+    for (size_t i = 0; i < size / align; ++i) {
+        if (!mv_read_field(tx->rv, get_field_lock(segment, first + i), &(segment->versions[first + i]),
+                           data + i * align, (char*)target + i * align, align))
+            return false;
+    }
+    return true;
+}
+
+/*
+ * Allocate nodes for values the commit will overwrite, after the write set
+ * is locked and validated, so write back can not fail
+ *
+ * False if could not allocate
+ */
+bool mv_prepare(transaction_t* tx) {
+    write_set_t* write_set = tx->write_set;
+    for (size_t i = 0; i < write_set->size; ++i) {
+        write_set->entries[i].node = mv_node_alloc(tx->ctx, tx->region->align);
+        if (!write_set->entries[i].node) {
+            mv_release(tx);
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Give back nodes of the write set that were not published, entries without
+ * a node have it NULL
+ */
+void mv_release(transaction_t* tx) {
+    write_set_t* write_set = tx->write_set;
+    for (size_t i = 0; i < write_set->size; ++i) {
+        if (write_set->entries[i].node) {
+            mv_node_free(tx->ctx, write_set->entries[i].node);
+            write_set->entries[i].node = NULL;
+        }
+    }
+}
+
+/*
+ * Cut the chain after its newest value not newer than the horizon
+ */
+static void mv_prune(transaction_t* tx, mv_node_t* node) {
+    thread_ctx_t* ctx = tx->ctx;
+    if (ctx->mv_commits-- == 0) {
+        ctx->mv_horizon = mv_horizon(tx->region);
+        ctx->mv_commits = MV_HORIZON_PERIOD;
+    }
+
+    while (node->version > ctx->mv_horizon) {
+        node = atomic_load_explicit(&(node->older), memory_order_relaxed);
+        if (!node)
+            return;
+    }
+    mv_node_t* tail = atomic_load_explicit(&(node->older), memory_order_relaxed);
+    if (!tail)
+        return;
+    /* Every reader stops at node at the latest, but some may be still
+       walking the tail, so it waits for them in limbo */
+    atomic_store_explicit(&(node->older), NULL, memory_order_relaxed);
+    epoch_retire_versions(tx->region, ctx, tail);
+}
+
+/*
+ * Push value the entry is about to overwrite to the chain of its field. The
+ * field is locked by the transaction, so no one else changes the chain.
+ */
+void mv_publish(transaction_t* tx, write_entry_t* entry) {
+    mv_node_t* node = entry->node;
+    entry->node = NULL;
+    node->version = entry->version;
+    memcpy(node->value, entry->data, tx->region->align);
+    atomic_store_explicit(&(node->older), 
+        atomic_load_explicit(entry->chain, memory_order_relaxed), memory_order_relaxed);
+    atomic_store_explicit(entry->chain, node, memory_order_release);
+    mv_count(tx->ctx, 1);
+    mv_prune(tx, node);
+}
+
+/*
+ * Give back list of versions no running transaction can access
+ */
+void mv_reclaim(thread_ctx_t* ctx, mv_node_t* node) {
+    while (node) {
+        mv_node_t* older = atomic_load_explicit(&(node->older), memory_order_relaxed);
+        mv_node_free(ctx, node);
+        mv_count(ctx, (uint64_t)-1);
+        node = older;
+    }
+}
+
+void mv_stats(region_t* region, tm_mv_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!region->multi_version)
+        return;
+    for (thread_ctx_t* ctx = atomic_load(&(region->threads)); ctx; ctx = ctx->next)
+        stats->versions += atomic_load_explicit(&(ctx->mv_versions), memory_order_relaxed);
+    stats->version_bytes = mv_node_size(region->align);
+    stats->bytes = stats->versions * stats->version_bytes;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "structs.h"
+#include "thread_ctx.h"
+
+/*
+ * Multi-version mode. Every field of a segment has a chain of its old values,
+ * newest first. Commit pushes the value it overwrites, with its version, to
+ * the chain of the field (holding the lock of the field). Read-only
+ * transaction reads the field in place if it is not newer than its snapshot,
+ * otherwise it takes the newest old value not newer than the snapshot, so it
+ * never aborts.
+ *
+ * Read-only transactions announce their snapshots, the oldest one is the
+ * horizon. Value in a chain older than the newest one not newer than the
+ * horizon is not needed by anyone, commits cut such tails off the chains
+ * they push to and retire them through epochs (see epoch.h).
+ */
+
+#define MV_IDLE UINT64_MAX          /* Announced snapshot of a thread without read-only transaction */
+#define MV_HORIZON_PERIOD 64        /* Hyperparameter, commits between recomputations of the horizon */
+#define MV_CACHE_DEPTH 1024         /* Hyperparameter, free versions kept per thread */
+#define MV_WAIT_SPINS 4096          /* Hyperparameter, spins on a locked field before yielding */
+
+/* One old value of a field */
+struct mv_node {
+    uint64_t version;               /* Version of the value */
+    _Atomic(struct mv_node*) older; /* Next older value, or next free node */
+    char value[];
+};
+typedef struct mv_node mv_node_t;
+
+int mv_segment_init(region_t* region, segment_descriptor_t* desc);
+void mv_segment_clear(thread_ctx_t* ctx, segment_descriptor_t* desc);
+void mv_segment_destroy(segment_descriptor_t* desc);
+void mv_ctx_destroy(thread_ctx_t* ctx);
+
+uint64_t mv_snapshot_begin(region_t* region, thread_ctx_t* ctx);
+bool mv_read(transaction_t* tx, segment_descriptor_t* segment, const void* source, size_t size, void* target);
+
+bool mv_prepare(transaction_t* tx);
+void mv_publish(transaction_t* tx, write_entry_t* entry);
+void mv_release(transaction_t* tx);
+void mv_reclaim(thread_ctx_t* ctx, mv_node_t* node);
+void mv_stats(region_t* region, tm_mv_stats_t* stats);
+
+/*
+ * Read-only transaction of the thread ended
+ */
+static inline void mv_snapshot_end(thread_ctx_t* ctx) {
+    atomic_store_explicit(&(ctx->mv_snapshot), MV_IDLE, memory_order_release);
+}
@@ -14,7 +14,11 @@
 
 #include "macros.h"
 #include "structs.h"
+#include "addressing.h"
+#include "vlock.h"
+#include "validate.h"
 #include "tm.h"
+#include "tm_ext.h"
 
 /*
 
@@ -77,6 +81,20 @@ void single_3();
 void multi_1(); /*  */
 void multi_2();
 
+/* Scenarios of tm_create_ext configurations */
+
+void atomic_1();
+void config_transfers(const char* name, const tm_config_t* config, size_t nums,
+                      unsigned writers, unsigned readers, bool give_up);
+void etl_1();
+void clock_1();
+void segment_1();
+void norec_1();
+void mvcc_1();
+void direct_1();
+void write_set_1();
+void validate_1();
+
 
 /* Global */
 
@@ -88,45 +106,61 @@ int main () {
 
     // multi_1();
     multi_2(10, 2);
+    atomic_1();
+    etl_1();
+    clock_1();
+    segment_1();
+    norec_1();
+    mvcc_1();
+    direct_1();
+    write_set_1();
+    validate_1();
     return 0;
 }
 
 
 
 
+/* One transfer of 1 from num1 to num2, run by tm_atomic until it commits */
+struct transfer {
+    void* start;
+    size_t align;
+    int num1, num2;
+};
+
+bool transfer_body(shared_t shared, tx_t tx, void* arg) {
+    struct transfer* transfer = (struct transfer*)arg;
+    long long val1, val2;
+    void* addr1 = transfer->start + transfer->align * transfer->num1;
+    void* addr2 = transfer->start + transfer->align * transfer->num2;
+
+    if (!tm_read(shared, tx, addr1, transfer->align, (void*)&val1))
+        return false; /* Transaction aborted, retry */
+    val1--;
+    if (!tm_write(shared, tx, (void*)&val1, transfer->align, addr1))
+        return false;
+
+    if (!tm_read(shared, tx, addr2, transfer->align, (void*)&val2))
+        return false;
+    val2++;
+    if (!tm_write(shared, tx, (void*)&val2, transfer->align, addr2))
+        return false;
+    return true;
+}
+
 void* multi_2_worker(void* nums_ptr) {
     unsigned seed = time(NULL) ^ getpid() ^ pthread_self();
-    long long* val1 = (long long*)malloc(sizeof(long long));
-    long long* val2 = (long long*)malloc(sizeof(long long));
-    void* start = tm_start(global_tm);
-    size_t align = tm_align(global_tm);
+    struct transfer transfer = {tm_start(global_tm), tm_align(global_tm), 0, 0};
     int nums = *((int*)nums_ptr);
 
     for (unsigned i = 0; i < multi_2_changes; ++i) {
-        int num1 = rand_r(&seed) % nums, num2 = rand_r(&seed) % nums;
-        // printf("num1: %d, num2: %d\n", num1, num2);
+        transfer.num1 = rand_r(&seed) % nums;
+        transfer.num2 = rand_r(&seed) % nums;
+        // printf("num1: %d, num2: %d\n", transfer.num1, transfer.num2);
 
-        tx_t tx = tm_begin(global_tm, false);
-        if (tx == invalid_tx)
+        if (!tm_atomic(global_tm, false, transfer_body, &transfer))
             continue; /* Transaction invalid, go next */
-
-        if (!tm_read(global_tm, tx, start + align * num1, align, (void*)val1))
-            continue; /* Transaction aborted, go next */
-        (*val1)--;
-        if (!tm_write(global_tm, tx, (void*)val1, align, start + align * num1))
-            continue; /* Transaction aborted, go next */
-
-        if (!tm_read(global_tm, tx, start + align * num2, align, (void*)val2))
-            continue; /* Transaction aborted, go next */
-        (*val2)++;
-        if (!tm_write(global_tm, tx, (void*)val2, align, start + align * num2))
-            continue; /* Transaction aborted, go next */
-
-        if (!tm_end(global_tm, tx))
-            continue; /* Transaction aborted, go next */
     }
-    free(val1);
-    free(val2);
     return NULL;
 }
 
@@ -184,37 +218,16 @@ void multi_2(const size_t nums, const unsigned threads) {
 
 void* multi_1_worker(void* unused(null)) {
     unsigned seed = time(NULL) ^ getpid() ^ pthread_self();
-    long long* val1 = (long long*)malloc(sizeof(long long));
-    long long* val2 = (long long*)malloc(sizeof(long long));
-    void* start = tm_start(global_tm);
-    size_t align = tm_align(global_tm);
+    struct transfer transfer = {tm_start(global_tm), tm_align(global_tm), 0, 0};
 
     for (unsigned i = 0; i < multi_1_changes; ++i) {
-        int num1 = rand_r(&seed) % 2, num2 = rand_r(&seed) % 2;
-        // printf("Worker: %lu, loop: %u, num1: %d, num2: %d\n", pthread_self(), i, num1, num2);
-        // num1 = 0, num2 = 1;
+        transfer.num1 = rand_r(&seed) % 2;
+        transfer.num2 = rand_r(&seed) % 2;
+        // printf("Worker: %lu, loop: %u, num1: %d, num2: %d\n", pthread_self(), i, transfer.num1, transfer.num2);
 
-        tx_t tx = tm_begin(global_tm, false);
-        if (tx == invalid_tx)
+        if (!tm_atomic(global_tm, false, transfer_body, &transfer))
             continue; /* Transaction invalid, go next */
-
-        if (!tm_read(global_tm, tx, start + align * num1, align, (void*)val1))
-            continue; /* Transaction aborted, go next */
-        (*val1)--;
-        if (!tm_write(global_tm, tx, (void*)val1, align, start + align * num1))
-            continue; /* Transaction aborted, go next */
-
-        if (!tm_read(global_tm, tx, start + align * num2, align, (void*)val2))
-            continue; /* Transaction aborted, go next */
-        (*val2)++;
-        if (!tm_write(global_tm, tx, (void*)val2, align, start + align * num2))
-            continue; /* Transaction aborted, go next */
-
-        if (!tm_end(global_tm, tx))
-            continue; /* Transaction aborted, go next */
     }
-    free(val1);
-    free(val2);
     return NULL;
 }
 
@@ -416,4 +429,519 @@ void single_3() {
     tm_destroy(tm);
     free(buffer1);
     free(buffer2);
-}
\ No newline at end of file
+}
+
+
+
+/* Body which gives up on its first attempt after writing, see atomic_1 */
+struct give_up {
+    void* field;
+    int attempts;
+};
+
+bool give_up_body(shared_t shared, tx_t tx, void* arg) {
+    struct give_up* give_up = (struct give_up*)arg;
+    long long value = ++give_up->attempts == 1 ? -1 : 1;
+    if (!tm_write(shared, tx, (void*)&value, sizeof(value), give_up->field))
+        return false;
+    return give_up->attempts > 1; /* First attempt returns false by itself */
+}
+
+void* atomic_1_reader(void* field) {
+    /* Field locked by a leaked transaction of another thread never reads */
+    long long* value = (long long*)malloc(sizeof(long long));
+    tx_t tx = tm_begin(global_tm, true);
+    assert(tx != invalid_tx);
+    assert(tm_read(global_tm, tx, field, sizeof(*value), (void*)value));
+    assert(tm_end(global_tm, tx));
+    return value;
+}
+
+void atomic_1() {
+    /*
+     * Body of tm_atomic returns false without any tm_* call aborting. Its
+     * write must be rolled back and its locks released, under every engine,
+     * so the retry and later transactions commit and see only the retry.
+     */
+    for (int engine = 0; engine < TM_ENGINE_COUNT; ++engine) {
+        tm_config_t config;
+        tm_config_default(&config);
+        config.engine = (tm_engine_t)engine;
+        shared_t tm = tm_create_ext(64, 8, &config);
+        assert(tm != invalid_shared);
+
+        struct give_up give_up = {tm_start(tm), 0};
+        assert(tm_atomic(tm, false, give_up_body, &give_up));
+        assert(give_up.attempts == 2);
+
+        global_tm = tm;
+        pthread_t reader;
+        long long* read;
+        assert(!pthread_create(&reader, NULL, atomic_1_reader, tm_start(tm)));
+        assert(!pthread_join(reader, (void**)&read));
+        assert(*read == 1);
+        free(read);
+
+        long long value = 0;
+        tx_t tx = tm_begin(tm, false);
+        assert(tx != invalid_tx);
+        assert(tm_read(tm, tx, tm_start(tm), sizeof(value), (void*)&value));
+        value++;
+        assert(tm_write(tm, tx, (void*)&value, sizeof(value), tm_start(tm)));
+        assert(tm_end(tm, tx));
+        assert(value == 2);
+        tm_destroy(tm);
+    }
+    printf("[atomic_1] FINAL CORRECT\n");
+}
+
+
+
+/* State of config_transfers shared by its threads */
+struct config_run {
+    shared_t tm;
+    size_t nums;
+    bool give_up;               /* Writers give up every other attempt after a write */
+    atomic_int writers;         /* Writers still running */
+    atomic_int wrong;           /* Scans whose sum was not 0 */
+    atomic_int scans;
+};
+
+/* Transfer of a config_transfers writer, with its attempts */
+struct config_transfer {
+    struct transfer transfer;
+    bool give_up;
+    unsigned attempts;
+};
+
+bool config_transfer_body(shared_t shared, tx_t tx, void* arg) {
+    struct config_transfer* config_transfer = (struct config_transfer*)arg;
+    struct transfer* transfer = &config_transfer->transfer;
+    if (config_transfer->give_up && config_transfer->attempts++ % 2 == 0) {
+        /* Value no scan may see, rolled back when the body returns false */
+        long long poison = 1000000;
+        if (!tm_write(shared, tx, (void*)&poison, transfer->align,
+                      transfer->start + transfer->align * transfer->num1))
+            return false;
+        return false;
+    }
+    return transfer_body(shared, tx, transfer);
+}
+
+/* Sum of all numbers, read by one transaction */
+struct scan {
+    void* start;
+    size_t align;
+    size_t nums;
+    long long sum;
+};
+
+bool scan_body(shared_t shared, tx_t tx, void* arg) {
+    struct scan* scan = (struct scan*)arg;
+    scan->sum = 0;
+    for (size_t i = 0; i < scan->nums; ++i) {
+        long long val;
+        if (!tm_read(shared, tx, scan->start + scan->align * i, scan->align, (void*)&val))
+            return false;
+        scan->sum += val;
+    }
+    return true;
+}
+
+void* config_writer(void* run_ptr) {
+    struct config_run* run = (struct config_run*)run_ptr;
+    unsigned seed = time(NULL) ^ getpid() ^ pthread_self();
+    struct config_transfer transfer = {{tm_start(run->tm), tm_align(run->tm), 0, 0}, run->give_up, 0};
+
+    for (unsigned i = 0; i < multi_2_changes * 10; ++i) {
+        transfer.transfer.num1 = rand_r(&seed) % run->nums;
+        transfer.transfer.num2 = rand_r(&seed) % run->nums;
+        assert(tm_atomic(run->tm, false, config_transfer_body, &transfer));
+    }
+    atomic_fetch_sub(&run->writers, 1);
+    return NULL;
+}
+
+void* config_reader(void* run_ptr) {
+    struct config_run* run = (struct config_run*)run_ptr;
+    struct scan scan = {tm_start(run->tm), tm_align(run->tm), run->nums, 0};
+
+    /* Scans alternate between read-only and read-write transactions */
+    for (bool is_ro = true; atomic_load(&run->writers) > 0; is_ro = !is_ro) {
+        assert(tm_atomic(run->tm, is_ro, scan_body, &scan));
+        if (scan.sum != 0)
+            atomic_fetch_add(&run->wrong, 1);
+        atomic_fetch_add(&run->scans, 1);
+    }
+    return NULL;
+}
+
+void config_transfers(const char* name, const tm_config_t* config, size_t nums,
+                      unsigned writers, unsigned readers, bool give_up) {
+    /*
+     * Same as multi_2 on a region of given configuration, while readers
+     * check that the sum is 0 in every transaction scanning all numbers.
+     */
+    struct config_run run;
+    run.tm = tm_create_ext(nums * sizeof(long long), sizeof(long long), config);
+    assert(run.tm != invalid_shared);
+    run.nums = nums;
+    run.give_up = give_up;
+    atomic_init(&run.writers, writers);
+    atomic_init(&run.wrong, 0);
+    atomic_init(&run.scans, 0);
+
+    pthread_t handlers[writers + readers];
+    for (unsigned i = 0; i < writers; i++)
+        assert(!pthread_create(&handlers[i], NULL, config_writer, &run));
+    for (unsigned i = writers; i < writers + readers; i++)
+        assert(!pthread_create(&handlers[i], NULL, config_reader, &run));
+    for (unsigned i = 0; i < writers + readers; i++)
+        assert(!pthread_join(handlers[i], NULL));
+
+    struct scan scan = {tm_start(run.tm), tm_align(run.tm), nums, 0};
+    assert(tm_atomic(run.tm, true, scan_body, &scan));
+    tm_destroy(run.tm);
+
+    bool correct = scan.sum == 0 && atomic_load(&run.wrong) == 0;
+    printf(correct ? "[%s] FINAL CORRECT\n" : "[%s] FINAL WRONG\n", name);
+    printf("[%s] sum: %lld, wrong scans: %d of %d\n", name, scan.sum, atomic_load(&run.wrong), atomic_load(&run.scans));
+    assert(correct);
+}
+
+/* Write given up, then lock sampled after its rollback, see etl_1 */
+struct rollback {
+    void* field;
+    vlock_t* lock;
+    uint64_t before, after;
+    int attempts;
+};
+
+bool rollback_body(shared_t shared, tx_t tx, void* arg) {
+    struct rollback* rollback = (struct rollback*)arg;
+    if (++rollback->attempts > 1) {
+        rollback->after = vlock_sample(rollback->lock);
+        return true; /* Commits without writes, lock stays as rollback left it */
+    }
+    long long poison = 1000000;
+    if (!tm_write(shared, tx, (void*)&poison, sizeof(poison), rollback->field))
+        return false;
+    return false;
+}
+
+void etl_1() {
+    /*
+     * ETL writes in place, so aborted writes must never be seen: writers
+     * write a poison value and give up every other attempt, against
+     * read-only (TL2 read path) and read-write (ETL read path) scans.
+     */
+    tm_config_t config;
+    tm_config_default(&config);
+    config.engine = TM_ENGINE_ETL;
+
+    /* Race of a scan with a rollback is too narrow to hit reliably, so check
+       directly that the rollback never brings back the version it undid */
+    shared_t tm = tm_create_ext(64, 8, &config);
+    assert(tm != invalid_shared);
+    segment_descriptor_t* segment = find_segment((region_t*)tm, tm_start(tm));
+    vlock_t* lock = get_field_lock(segment, find_field_number(segment, tm_start(tm)));
+    struct rollback rollback = {tm_start(tm), lock, vlock_sample(lock), 0, 0};
+    assert(tm_atomic(tm, false, rollback_body, &rollback));
+    assert(rollback.attempts == 2);
+    assert(!vlock_is_locked(rollback.after) && vlock_version(rollback.after) > vlock_version(rollback.before));
+    tm_destroy(tm);
+
+    config_transfers("etl_1", &config, 10, 2, 2, false);
+    config_transfers("etl_1 give up", &config, 10, 2, 2, true);
+    config.clock = TM_CLOCK_GV4;
+    config_transfers("etl_1 give up gv4", &config, 10, 2, 2, true);
+}
+
+
+
+/* Thread of clock_1, index of its own field */
+struct clock_worker {
+    size_t field;
+    int aborts;
+};
+
+void* clock_1_worker(void* worker_ptr) {
+    struct clock_worker* worker = (struct clock_worker*)worker_ptr;
+    void* field = tm_start(global_tm) + worker->field * tm_align(global_tm);
+
+    for (int i = 0; i < multi_2_changes * 10; ++i) {
+        long long value;
+        tx_t tx = tm_begin(global_tm, false);
+        assert(tx != invalid_tx);
+        if (!tm_read(global_tm, tx, field, sizeof(value), (void*)&value)) {
+            worker->aborts++;
+            continue;
+        }
+        value++;
+        if (!tm_write(global_tm, tx, (void*)&value, sizeof(value), field) || !tm_end(global_tm, tx))
+            worker->aborts++;
+    }
+    return NULL;
+}
+
+void clock_1() {
+    /*
+     * Threads increment their own fields, which never conflict, so no clock
+     * scheme may abort. GV5 and GV6 publish versions ahead of the clock,
+     * which the next read of the field has to catch up with.
+     */
+    const unsigned threads = 4;
+    for (int scheme = 0; scheme < TM_CLOCK_COUNT; ++scheme) {
+        tm_config_t config;
+        tm_config_default(&config);
+        config.clock = (tm_clock_t)scheme;
+        global_tm = tm_create_ext(threads * 64, 8, &config);
+        assert(global_tm != invalid_shared);
+
+        pthread_t handlers[threads];
+        struct clock_worker workers[threads];
+        for (unsigned i = 0; i < threads; i++) {
+            workers[i].field = i * 8; /* Own cache line */
+            workers[i].aborts = 0;
+            assert(!pthread_create(&handlers[i], NULL, clock_1_worker, &workers[i]));
+        }
+        int aborts = 0;
+        for (unsigned i = 0; i < threads; i++) {
+            assert(!pthread_join(handlers[i], NULL));
+            aborts += workers[i].aborts;
+        }
+        tm_destroy(global_tm);
+        printf(aborts == 0 ? "[clock_1] scheme %d FINAL CORRECT\n" : "[clock_1] scheme %d FINAL WRONG\n", scheme);
+        assert(aborts == 0);
+    }
+}
+
+
+
+/* Allocate a segment in its own transaction */
+void* segment_1_alloc(shared_t tm) {
+    void* segment;
+    tx_t tx = tm_begin(tm, false);
+    assert(tx != invalid_tx);
+    assert(tm_alloc(tm, tx, 1048, &segment) == success_alloc);
+    assert(tm_end(tm, tx));
+    return segment;
+}
+
+/* Free a segment in its own transaction */
+void segment_1_free(shared_t tm, void* segment) {
+    tx_t tx = tm_begin(tm, false);
+    assert(tx != invalid_tx);
+    assert(tm_free(tm, tx, segment));
+    assert(tm_end(tm, tx));
+}
+
+void segment_1() {
+    /*
+     * Freed segments come back with their numbers under a new generation,
+     * so an address kept from before the free must not reach the new
+     * segment: reads, writes and frees through it abort.
+     */
+    shared_t tm = tm_create(64, 8);
+    assert(tm != invalid_shared);
+
+    /* Freed segments are reused once no transaction can see them */
+    void* segment = NULL;
+    for (int i = 0; i < 1000 && !segment; ++i) {
+        void* candidate = segment_1_alloc(tm);
+        if (get_segment_generation(candidate) > 0)
+            segment = candidate;
+        else
+            segment_1_free(tm, candidate);
+    }
+    assert(segment);
+    void* stale = build_virtual_address(get_segment_num(segment), get_segment_generation(segment) - 1, 0);
+
+    long long value = 7;
+    tx_t tx = tm_begin(tm, false);
+    assert(tx != invalid_tx);
+    assert(!tm_write(tm, tx, (void*)&value, sizeof(value), stale));
+    tx = tm_begin(tm, false);
+    assert(tx != invalid_tx);
+    assert(!tm_read(tm, tx, stale, sizeof(value), (void*)&value));
+    tx = tm_begin(tm, false);
+    assert(tx != invalid_tx);
+    assert(!tm_free(tm, tx, stale));
+
+    tx = tm_begin(tm, false);
+    assert(tx != invalid_tx);
+    assert(tm_read(tm, tx, segment, sizeof(value), (void*)&value));
+    assert(value == 0);
+    assert(tm_end(tm, tx));
+    tm_destroy(tm);
+    printf("[segment_1] FINAL CORRECT\n");
+}
+
+
+
+void norec_1() {
+    /*
+     * NOrec validates reads by value under its sequence lock, with no field
+     * locks: scans of every number must still see a sum of 0, and writes
+     * of an attempt that gives up must never be seen.
+     */
+    tm_config_t config;
+    tm_config_default(&config);
+    config.engine = TM_ENGINE_NOREC;
+    config_transfers("norec_1", &config, 10, 2, 2, false);
+    config_transfers("norec_1 give up", &config, 10, 2, 2, true);
+}
+
+
+
+/* Transfers committed by another thread, see mvcc_1 */
+void* mvcc_1_writer(void* transfer) {
+    for (int i = 0; i < 10; ++i)
+        assert(tm_atomic(global_tm, false, transfer_body, transfer));
+    return NULL;
+}
+
+void mvcc_1() {
+    /*
+     * Read-only transactions of a multi-version region read the values of
+     * their snapshot: one which reads the first number, lets another thread
+     * commit transfers from it and then reads the second, still sees the
+     * old values instead of aborting. Then transfers and scans as in etl_1.
+     */
+    tm_config_t config;
+    tm_config_default(&config);
+    config.multi_version = true;
+
+    global_tm = tm_create_ext(2 * sizeof(long long), sizeof(long long), &config);
+    assert(global_tm != invalid_shared);
+    struct transfer transfer = {tm_start(global_tm), tm_align(global_tm), 0, 1};
+    long long val1, val2;
+    tx_t tx = tm_begin(global_tm, true);
+    assert(tx != invalid_tx);
+    assert(tm_read(global_tm, tx, transfer.start, sizeof(val1), (void*)&val1));
+    pthread_t writer;
+    assert(!pthread_create(&writer, NULL, mvcc_1_writer, &transfer));
+    assert(!pthread_join(writer, NULL));
+    assert(tm_read(global_tm, tx, transfer.start + transfer.align, sizeof(val2), (void*)&val2));
+    assert(tm_end(global_tm, tx));
+    assert(val1 == 0 && val2 == 0);
+    tm_destroy(global_tm);
+
+    config_transfers("mvcc_1", &config, 10, 2, 2, false);
+    config_transfers("mvcc_1 give up", &config, 10, 2, 2, true);
+    config.clock = TM_CLOCK_GV4;
+    config_transfers("mvcc_1 give up gv4", &config, 10, 2, 2, true);
+}
+
+
+
+void direct_1() {
+    /*
+     * Addresses of a direct-mapped region are offsets into one reservation,
+     * translated with no lookup: an allocated segment keeps what was
+     * written to it apart from the first segment, and every engine still
+     * keeps the sum of concurrent transfers at 0.
+     */
+    tm_config_t config;
+    tm_config_default(&config);
+    config.direct_mapped = true;
+
+    shared_t tm = tm_create_ext(2 * sizeof(long long), sizeof(long long), &config);
+    assert(tm != invalid_shared);
+    void* segment;
+    long long value = 42;
+    tx_t tx = tm_begin(tm, false);
+    assert(tx != invalid_tx);
+    assert(tm_alloc(tm, tx, 1048, &segment) == success_alloc);
+    assert(tm_write(tm, tx, (void*)&value, sizeof(value), segment + 1040));
+    assert(tm_end(tm, tx));
+
+    struct scan scan = {tm_start(tm), tm_align(tm), 2, 0};
+    assert(tm_atomic(tm, true, scan_body, &scan));
+    assert(scan.sum == 0);
+    tx = tm_begin(tm, true);
+    assert(tx != invalid_tx);
+    assert(tm_read(tm, tx, segment + 1040, sizeof(value), (void*)&value));
+    assert(tm_end(tm, tx));
+    assert(value == 42);
+    tx = tm_begin(tm, false);
+    assert(tx != invalid_tx);
+    assert(tm_free(tm, tx, segment));
+    assert(tm_end(tm, tx));
+    tm_destroy(tm);
+
+    const char* names[TM_ENGINE_COUNT] = {"direct_1 tl2", "direct_1 norec", "direct_1 etl"};
+    for (int engine = 0; engine < TM_ENGINE_COUNT; ++engine) {
+        config.engine = (tm_engine_t)engine;
+        config_transfers(names[engine], &config, 10, 2, 2, true);
+    }
+}
+
+
+
+void write_set_1() {
+    /*
+     * Entry dropped after its value could not be allocated must leave no
+     * slot behind: write set is reused by the next transaction, where the
+     * stale slot would be found first for the same target, pointing past
+     * the entries with no value.
+     */
+    write_set_t* ws = write_set_init(WRITE_SET_DEFAULT_SIZE);
+    assert(ws);
+    long long fields[2];
+    bool inserted;
+    assert(write_set_insert(ws, &fields[0], &inserted) && inserted);
+    assert(write_set_insert(ws, &fields[1], &inserted) && inserted);
+    write_set_drop_last(ws);
+    assert(ws->size == 1 && !write_set_find(ws, &fields[1]));
+    write_set_clear(ws);
+
+    write_entry_t* entry = write_set_insert(ws, &fields[1], &inserted);
+    assert(entry == &(ws->entries[0]) && inserted);
+    assert(write_set_find(ws, &fields[1]) == entry);
+    assert(write_set_insert(ws, &fields[1], &inserted) == entry && !inserted);
+    write_set_destroy(ws);
+    printf("[write_set_1] FINAL CORRECT\n");
+}
+
+
+
+void validate_1() {
+    /*
+     * Every kernel the CPU supports must stop exactly where the scalar one
+     * does: at a changed version or a locked word planted at each index in
+     * turn, of read sets around the ends of 4 and 8 entry blocks.
+     */
+    static const size_t sizes[] = { 0, 1, 3, 4, 5, 7, 8, 9, 12, 16, 17, 33 };
+    size_t max = sizes[sizeof(sizes) / sizeof(sizes[0]) - 1];
+    vlock_t locks[max];
+    read_entry_t entries[max];
+    validate_kernel_t scalar = validate_kernel_of(VALIDATE_SCALAR);
+
+    for (int isa = 0; isa < VALIDATE_ISA_COUNT; ++isa) {
+        validate_kernel_t kernel = validate_kernel_of((validate_isa_t)isa);
+        if (!kernel)
+            continue;
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+            size_t n = sizes[s];
+            for (size_t i = 0; i < n; ++i) {
+                /* Entries point to locks in reverse order, as reads need not
+                   follow the layout */
+                entries[i].lock = &(locks[n - 1 - i]);
+                entries[i].version = 3 * i + 1;
+                atomic_init(entries[i].lock, vlock_free_word(entries[i].version));
+            }
+            assert(kernel(entries, n) == n);
+            for (size_t i = 0; i < n; ++i) {
+                uint64_t planted[2] = { vlock_free_word(entries[i].version + 1), vlock_owned_word(locks) };
+                for (int p = 0; p < 2; ++p) {
+                    atomic_store(entries[i].lock, planted[p]);
+                    assert(scalar(entries, n) == i);
+                    assert(kernel(entries, n) == i);
+                }
+                atomic_store(entries[i].lock, vlock_free_word(entries[i].version));
+            }
+        }
+        printf("[validate_1] %s FINAL CORRECT\n", validate_isa_names[isa]);
+    }
+}
@@ -0,0 +1,200 @@
+#include <string.h>
+
+#include "norec.h"
+#include "engine.h"
+#include "addressing.h"
+#include "stats.h"
+
+/*
+ * NOrec engine. The only metadata is one global sequence lock (the global
+ * clock of the region, even while free), so segments have no versioned
+ * locks. Transaction remembers the value of the lock it last validated at
+ * (its rv) and the values it read. Reads are consistent as long as the lock
+ * did not move since, otherwise the transaction revalidates by comparing
+ * its reads with the memory. Commit takes the lock, writes back and releases
+ * it, so commits are serialized, which suits small write-light regions.
+ */
+
+value_log_t* value_log_init(size_t n) {
+    value_log_t* log = (value_log_t*)malloc(sizeof(value_log_t));
+    if (!log)
+        return NULL;
+    log->entries = (value_entry_t*)malloc(n * sizeof(value_entry_t));
+    if (!log->entries) {
+        free(log);
+        return NULL;
+    }
+    log->values = arena_init(ARENA_DEFAULT_CHUNK);
+    if (!log->values) {
+        free(log->entries);
+        free(log);
+        return NULL;
+    }
+    log->size = 0;
+    log->size_max = n;
+    return log;
+}
+
+void value_log_destroy(value_log_t* log) {
+    arena_destroy(log->values);
+    free(log->entries);
+    free(log);
+}
+
+void value_log_clear(value_log_t* log) {
+    log->size = 0;
+    arena_reset(log->values);
+}
+
+/*
+ * Remember size bytes read from data, false if could not allocate
+ */
+static bool value_log_push(value_log_t* log, const void* data, const void* value, size_t size) {
+    if (log->size == log->size_max) {
+        size_t size_max = 2 * log->size_max;
+        value_entry_t* entries = (value_entry_t*)realloc(log->entries, size_max * sizeof(value_entry_t));
+        if (!entries)
+            return false;
+        log->entries = entries;
+        log->size_max = size_max;
+    }
+    void* copy = arena_alloc(log->values, size);
+    if (!copy)
+        return false;
+    memcpy(copy, value, size);
+    log->entries[log->size].data = data;
+    log->entries[log->size].value = copy;
+    log->entries[log->size].size = size;
+    log->size++;
+    return true;
+}
+
+/*
+ * Value of the sequence lock once it is free
+ */
+static inline uint64_t norec_wait(region_t* region) {
+    for (;;) {
+        uint64_t time = atomic_load_explicit(&(region->global_clock), memory_order_acquire);
+        if (!(time & 1))
+            return time;
+        cpu_relax();
+    }
+}
+
+/*
+ * Check that everything the transaction read still has the same value, at
+ * a moment when no commit was writing. On success the transaction is
+ * consistent at the new value of the lock, which becomes its rv.
+ */
+static bool norec_validate(transaction_t* tx) {
+    region_t* region = tx->region;
+    value_log_t* log = tx->value_log;
+    for (;;) {
+        uint64_t time = norec_wait(region);
+        for (size_t i = 0; i < log->size; ++i) {
+            if (memcmp(log->entries[i].data, log->entries[i].value, log->entries[i].size) != 0)
+                return false; /* Read value was overwritten */
+        }
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&(region->global_clock), memory_order_relaxed) == time) {
+            tx->rv = time;
+            return true;
+        }
+    }
+}
+
+/*
+ * Copy size bytes from data, consistent with everything read before
+ */
+static bool norec_load(transaction_t* tx, const void* data, void* target, size_t size) {
+    for (;;) {
+        memcpy(target, data, size);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&(tx->region->global_clock), memory_order_relaxed) == tx->rv)
+            break;
+        /* Some commit happened since the last validation */
+        if (!norec_validate(tx))
+            return stats_abort(tx, TM_ABORT_VALIDATION);
+    }
+    return value_log_push(tx->value_log, data, target, size) || stats_abort(tx, TM_ABORT_NOMEM);
+}
+
+static void norec_begin(transaction_t* tx) {
+    tx->rv = norec_wait(tx->region);
+}
+
+static bool norec_read(transaction_t* tx, segment_descriptor_t* segment, const void* source, size_t size, void* target) {
+    const char* data = get_physical_address(segment, source);
+    if (tx->is_ro || tx->write_set->size == 0) {
+        /* Nothing is buffered, the whole range is read at once */
+        return norec_load(tx, data, target, size);
+    }
+
+    size_t align = segment->align;
+    for (size_t offset = 0; offset < size; offset += align) {
+        write_entry_t* entry = write_set_find(tx->write_set, (const char*)source + offset);
+        if (entry)
+            memcpy((char*)target + offset, entry->value, align);
+        else if (!norec_load(tx, data + offset, (char*)target + offset, align))
+            return false;
+    }
+    return true;
+}
+
+static bool norec_write(transaction_t* tx, segment_descriptor_t* segment, const void* source, size_t size, void* target) {
+    size_t align = segment->align;
+    for (size_t offset = 0; offset < size; offset += align) {
+        bool inserted;
+        write_entry_t* entry = write_set_insert(tx->write_set, (char*)target + offset, &inserted);
+        if (!entry)
+            return stats_abort(tx, TM_ABORT_NOMEM); /* Could not add to write_set, abort */
+        if (inserted) {
+            entry->value = arena_alloc(tx->write_values, align);
+            if (!entry->value) {
+                /* Drop the half built entry, it is the last one */
+                write_set_drop_last(tx->write_set);
+                return stats_abort(tx, TM_ABORT_NOMEM);
+            }
+            entry->data = get_physical_address(segment, (char*)target + offset);
+        }
+        memcpy(entry->value, (const char*)source + offset, align);
+    }
+    return true;
+}
+
+static bool norec_end(transaction_t* tx) {
+    write_set_t* write_set = tx->write_set;
+    if (tx->is_ro || write_set->size == 0) {
+        /* Every read was consistent at rv */
+        return true;
+    }
+
+    region_t* region = tx->region;
+    uint64_t time = tx->rv;
+    while (!atomic_compare_exchange_strong_explicit(&(region->global_clock), &time, tx->rv + 1,
+            memory_order_acquire, memory_order_relaxed)) {
+        /* Another transaction commited, reads must still hold */
+        if (!norec_validate(tx))
+            return stats_abort(tx, TM_ABORT_VALIDATION);
+        time = tx->rv;
+    }
+    /* Writes done after locking are not visible before the lock */
+    atomic_thread_fence(memory_order_release);
+
+    for (size_t i = 0; i < write_set->size; ++i) {
+        write_entry_t* entry = &(write_set->entries[i]);
+        memcpy(entry->data, entry->value, region->align);
+    }
+    atomic_store_explicit(&(region->global_clock), tx->rv + 2, memory_order_release);
+    return true;
+}
+
+const engine_t norec_engine = {
+    .begin = norec_begin,
+    .read = norec_read,
+    .write = norec_write,
+    .end = norec_end,
+    .abort = NULL,
+    .field_locks = false,
+    .value_log = true,
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+#define VALUE_LOG_DEFAULT_SIZE 64 /* Hyperparameter */
+
+/* One read of a NOrec transaction, with copy of the read bytes */
+struct value_entry {
+    const void* data;           /* Physical address of the read bytes */
+    const void* value;          /* Copy of the bytes when they were read */
+    size_t size;
+};
+typedef struct value_entry value_entry_t;
+
+/*
+ * Reads of a transaction, validated by comparing the values in memory with
+ * the values read (see norec.c). Copies live in the arena of the log.
+ */
+struct value_log {
+    value_entry_t* entries;
+    size_t size, size_max;
+    arena_t* values;
+};
+typedef struct value_log value_log_t;
+
+value_log_t* value_log_init(size_t n);
+void value_log_destroy(value_log_t* log);
+void value_log_clear(value_log_t* log);
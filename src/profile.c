@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "profile.h"
+#include "addressing.h"
+
+#if TM_STATS
+
+/* Odd multipliers of the row hashes */
+static const uint64_t profile_hashes[PROFILE_DEPTH] = {
+    0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, 0xD6E8FEB86659FD93ull
+};
+
+static inline size_t profile_slot(size_t row, uintptr_t address) {
+    /* High bits of the product depend on all bits of the address */
+    return (size_t)(((uint64_t)address * profile_hashes[row]) >> (64 - __builtin_ctz(PROFILE_WIDTH)));
+}
+
+static uint64_t profile_estimate(profile_t* profile, uintptr_t address) {
+    uint64_t estimate = UINT32_MAX;
+    for (size_t row = 0; row < PROFILE_DEPTH; ++row) {
+        uint32_t count = atomic_load_explicit(&(profile->counts[row][profile_slot(row, address)]), memory_order_relaxed);
+        if (count < estimate)
+            estimate = count;
+    }
+    return estimate;
+}
+
+static int profile_compare(const void* a, const void* b) {
+    uint64_t left = ((const tm_hot_field_t*)a)->conflicts;
+    uint64_t right = ((const tm_hot_field_t*)b)->conflicts;
+    return left < right ? 1 : left > right ? -1 : 0;
+}
+
+#endif
+
+int profile_init(region_t* region) {
+#if TM_STATS
+    region->profile = (profile_t*)malloc(sizeof(profile_t));
+    if (!region->profile)
+        return INIT_FAIL;
+    profile_reset(region);
+#else
+    (void)region;
+#endif
+    return INIT_SUCCESS;
+}
+
+void profile_destroy(region_t* region) {
+#if TM_STATS
+    free(region->profile);
+#else
+    (void)region;
+#endif
+}
+
+/*
+ * Forget all conflicts, counts of concurrent records may survive
+ */
+void profile_reset(region_t* region) {
+#if TM_STATS
+    profile_t* profile = region->profile;
+    for (size_t row = 0; row < PROFILE_DEPTH; ++row) {
+        for (size_t i = 0; i < PROFILE_WIDTH; ++i)
+            atomic_store_explicit(&(profile->counts[row][i]), 0, memory_order_relaxed);
+    }
+    for (size_t i = 0; i < PROFILE_TOP; ++i)
+        atomic_store_explicit(&(profile->top[i]), 0, memory_order_relaxed);
+#else
+    (void)region;
+#endif
+}
+
+/*
+ * Count one sampled conflict of the field at given virtual address
+ */
+void profile_record(region_t* region, const void* address) {
+#if TM_STATS
+    profile_t* profile = region->profile;
+    uintptr_t key = (uintptr_t)address;
+    uint64_t estimate = UINT32_MAX;
+    for (size_t row = 0; row < PROFILE_DEPTH; ++row) {
+        uint32_t count = atomic_fetch_add_explicit(&(profile->counts[row][profile_slot(row, key)]), 1, memory_order_relaxed) + 1;
+        if (count < estimate)
+            estimate = count;
+    }
+
+    /* Replace the weakest candidate, unless the address already is one */
+    size_t weakest = 0;
+    uintptr_t weakest_key = 0;
+    uint64_t weakest_estimate = UINT64_MAX;
+    for (size_t i = 0; i < PROFILE_TOP; ++i) {
+        uintptr_t candidate = atomic_load_explicit(&(profile->top[i]), memory_order_relaxed);
+        if (candidate == key)
+            return;
+        uint64_t candidate_estimate = candidate ? profile_estimate(profile, candidate) : 0;
+        if (candidate_estimate < weakest_estimate) {
+            weakest = i;
+            weakest_key = candidate;
+            weakest_estimate = candidate_estimate;
+        }
+    }
+    if (estimate > weakest_estimate)
+        atomic_compare_exchange_strong_explicit(&(profile->top[weakest]), &weakest_key, key,
+                                                memory_order_relaxed, memory_order_relaxed);
+#else
+    (void)region;
+    (void)address;
+#endif
+}
+
+/*
+ * Fill fields with at most k candidates of highest estimates, in descending
+ * order, return their number
+ */
+size_t profile_top(region_t* region, tm_hot_field_t* fields, size_t k) {
+#if TM_STATS
+    profile_t* profile = region->profile;
+    size_t align_shift = (size_t)__builtin_ctzl(region->align);
+    tm_hot_field_t candidates[PROFILE_TOP];
+    size_t count = 0;
+    for (size_t i = 0; i < PROFILE_TOP; ++i) {
+        uintptr_t key = atomic_load_explicit(&(profile->top[i]), memory_order_relaxed);
+        bool seen = false; /* Racing records may have put it in two slots */
+        for (size_t j = 0; j < count && !seen; ++j)
+            seen = (uintptr_t)candidates[j].address == key;
+        if (!key || seen)
+            continue;
+        tm_hot_field_t* field = &(candidates[count++]);
+        field->address = (void*)key;
+        if (region->direct) {
+            field->segment = UINT32_MAX;
+            field->field = key >> align_shift;
+        }
+        else {
+            field->segment = get_segment_num(field->address);
+            field->field = get_segment_offset(field->address) >> align_shift;
+        }
+        field->conflicts = profile_estimate(profile, key) * PROFILE_SAMPLE_PERIOD;
+    }
+    qsort(candidates, count, sizeof(tm_hot_field_t), profile_compare);
+    if (count > k)
+        count = k;
+    memcpy(fields, candidates, count * sizeof(tm_hot_field_t));
+    return count;
+#else
+    (void)region;
+    (void)fields;
+    (void)k;
+    return 0;
+#endif
+}
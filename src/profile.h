@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include <tm_ext.h>
+
+#include "structs.h"
+#include "thread_ctx.h"
+
+#define PROFILE_DEPTH 4         /* Hyperparameter, rows of the count-min sketch */
+#define PROFILE_WIDTH 4096      /* Hyperparameter, counters per row (power of 2) */
+#define PROFILE_TOP 64          /* Hyperparameter, candidates for the hottest fields */
+#define PROFILE_SAMPLE_PERIOD 4 /* Hyperparameter, one conflict in this many is recorded (power of 2) */
+
+/*
+ * Conflict profile of a region (tm_hot_fields), compiled only with TM_STATS
+ * like the rest of statistics, see stats.h.
+ *
+ * Engines report the virtual address of the field behind an abort with
+ * profile_conflict, which samples one report in PROFILE_SAMPLE_PERIOD. The
+ * sample is counted in a count-min sketch shared by all threads: every row
+ * hashes the address to one counter, and the estimate of an address is the
+ * smallest of its counters, which only overcounts when all rows collide.
+ * Counters are only ever incremented atomically, so no lock is needed.
+ *
+ * The sketch can not be enumerated, so the addresses themselves are kept in
+ * a small table of candidates: an address whose estimate beats the weakest
+ * candidate replaces it with a CAS. Races can lose a replacement, which is
+ * fine for a profile, hot addresses keep being sampled.
+ */
+struct profile {
+    _Atomic(uint32_t) counts[PROFILE_DEPTH][PROFILE_WIDTH];
+    _Atomic(uintptr_t) top[PROFILE_TOP]; /* Candidate addresses, 0 for none */
+};
+typedef struct profile profile_t;
+
+int profile_init(region_t* region);
+void profile_destroy(region_t* region);
+void profile_reset(region_t* region);
+void profile_record(region_t* region, const void* address);
+size_t profile_top(region_t* region, tm_hot_field_t* fields, size_t k);
+
+/*
+ * Field of given virtual address caused an abort of the transaction
+ */
+static inline void profile_conflict(transaction_t* tx, const void* address) {
+#if TM_STATS
+    if ((thread_ctx_random(tx->ctx) & (PROFILE_SAMPLE_PERIOD - 1)) == 0)
+        profile_record(tx->region, address);
+#else
+    (void)tx;
+    (void)address;
+#endif
+}
@@ -0,0 +1,71 @@
+#include <string.h>
+
+#include "read_set.h"
+
+read_set_t* read_set_init(size_t n) {
+    read_set_t* rs = (read_set_t*)malloc(sizeof(read_set_t));
+    if (!rs)
+        return NULL;
+    rs->entries = (read_entry_t*)malloc(n * sizeof(read_entry_t));
+    rs->addresses = (const void**)malloc(n * sizeof(const void*));
+    if (!rs->entries || !rs->addresses) {
+        free(rs->entries);
+        free(rs->addresses);
+        free(rs);
+        return NULL;
+    }
+    rs->size = 0;
+    rs->size_max = n;
+    memset(rs->recent, 0, sizeof(rs->recent));
+    return rs;
+}
+
+void read_set_destroy(read_set_t* rs) {
+    free(rs->entries);
+    free(rs->addresses);
+    free(rs);
+}
+
+/*
+ * Make room for n more entries, false if could not allocate
+ */
+bool read_set_reserve(read_set_t* rs, size_t n) {
+    if (rs->size + n <= rs->size_max)
+        return true;
+    size_t size_max = 2 * rs->size_max;
+    while (size_max < rs->size + n)
+        size_max *= 2;
+    read_entry_t* entries = (read_entry_t*)realloc(rs->entries, size_max * sizeof(read_entry_t));
+    if (!entries)
+        return false;
+    rs->entries = entries;
+    const void** addresses = (const void**)realloc(rs->addresses, size_max * sizeof(const void*));
+    if (!addresses)
+        return false; /* Entries are bigger, but no more than size_max are used */
+    rs->addresses = addresses;
+    rs->size_max = size_max;
+    return true;
+}
+
+/*
+ * Add n entries which were filled in past the end of the set (after
+ * read_set_reserve), without their addresses. Fields which were recently
+ * read are dropped, the same as by read_set_push.
+ *
+ * False if some field was read before with other version
+ */
+bool read_set_append(read_set_t* rs, size_t n) {
+    size_t end = rs->size + n;
+    for (size_t i = rs->size; i < end; ++i) {
+        read_entry_t entry = rs->entries[i];
+        uint32_t* slot = read_set_slot(rs, entry.lock);
+        if (*slot < rs->size && rs->entries[*slot].lock == entry.lock) {
+            if (rs->entries[*slot].version != entry.version)
+                return false;
+            continue;
+        }
+        *slot = (uint32_t)rs->size;
+        rs->entries[rs->size++] = entry;
+    }
+    return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "vlock.h"
+
+#define READ_SET_DEFAULT_SIZE 64 /* Hyperparameter */
+#define READ_SET_RECENT 64      /* Hyperparameter, slots of the table of recent reads (power of 2) */
+
+/* One read of a transaction, with version the field had when it was read */
+struct read_entry {
+    vlock_t* lock;              /* Versioned lock of the read field */
+    uint64_t version;
+};
+typedef struct read_entry read_entry_t;
+
+/*
+ * Read set of a transaction, entries in order of reads. Versions let the
+ * transaction revalidate its reads at any time, see tl2_extend, which is a
+ * linear pass over the entries.
+ *
+ * Repeated reads of a field are recognized by a direct-mapped table, whose
+ * slots hold index of the last entry of a lock hashing to them. Slots are
+ * checked against the entries, so the table is never cleared: slot of an
+ * earlier transaction points past the end or to entry of other lock.
+ */
+struct read_set {
+    read_entry_t* entries;
+    /* Virtual addresses of the entries, needed only to find fields locked by
+       the transaction itself in its write set. Read-only transactions lock
+       nothing, so they leave them unset. */
+    const void** addresses;
+    size_t size, size_max;
+    uint32_t recent[READ_SET_RECENT];
+};
+typedef struct read_set read_set_t;
+
+read_set_t* read_set_init(size_t n);
+void read_set_destroy(read_set_t* rs);
+bool read_set_reserve(read_set_t* rs, size_t n);
+bool read_set_append(read_set_t* rs, size_t n);
+
+static inline uint32_t* read_set_slot(read_set_t* rs, const vlock_t* lock) {
+    return &(rs->recent[((uintptr_t)lock / sizeof(vlock_t)) & (READ_SET_RECENT - 1)]);
+}
+
+/*
+ * Add one read, unless the field was recently read with the same version.
+ *
+ * False if the field was read before with other version, the earlier read
+ * can not be valid anymore, or if could not allocate
+ */
+static inline bool read_set_push(read_set_t* rs, vlock_t* lock, const void* address, uint64_t version) {
+    uint32_t* slot = read_set_slot(rs, lock);
+    if (*slot < rs->size && rs->entries[*slot].lock == lock)
+        return rs->entries[*slot].version == version;
+    if (rs->size == rs->size_max && !read_set_reserve(rs, 1))
+        return false;
+    rs->entries[rs->size].lock = lock;
+    rs->entries[rs->size].version = version;
+    rs->addresses[rs->size] = address;
+    *slot = (uint32_t)rs->size;
+    rs->size++;
+    return true;
+}
@@ -0,0 +1,65 @@
+// Requested feature: sched_yield
+#define _POSIX_C_SOURCE   200809L
+
+#include <sched.h>
+
+#include "scheduler.h"
+
+/*
+ * Spin until the transaction of owner with given ticket ends, false if it
+ * did not within SCHED_WAIT_SPINS
+ */
+static bool sched_wait(thread_ctx_t* owner, uint64_t ticket) {
+    for (size_t spins = 0; spins < SCHED_WAIT_SPINS; ++spins) {
+        if (atomic_load_explicit(&(owner->sched_ticket), memory_order_acquire) != ticket)
+            return true;
+        cpu_relax();
+    }
+    return false;
+}
+
+/*
+ * Publish the writing transaction the thread starts, and wait for earlier
+ * ones it would likely conflict with if the thread aborts often
+ */
+void sched_begin(region_t* region, thread_ctx_t* ctx) {
+    uint64_t predicted = ctx->sched_predicted;
+    ctx->sched_writes = 0;
+    atomic_store_explicit(&(ctx->sched_signature), predicted, memory_order_relaxed);
+    /* Released with the ticket, so whoever sees the ticket sees the signature */
+    uint64_t ticket = atomic_fetch_add_explicit(&(region->sched_tickets), 1, memory_order_relaxed) + 1;
+    atomic_store_explicit(&(ctx->sched_ticket), ticket, memory_order_release);
+    if (ctx->sched_aborts < SCHED_THRESHOLD || predicted == 0)
+        return;
+
+    /* Contexts are only prepended, so the list can be walked concurrently */
+    for (thread_ctx_t* owner = atomic_load(&(region->threads)); owner; owner = owner->next) {
+        if (owner == ctx)
+            continue;
+        uint64_t owner_ticket = atomic_load_explicit(&(owner->sched_ticket), memory_order_acquire);
+        if (owner_ticket == 0 || owner_ticket > ticket)
+            continue;
+        if (!(atomic_load_explicit(&(owner->sched_signature), memory_order_relaxed) & predicted))
+            continue;
+        for (size_t yields = 0; yields < SCHED_WAIT_YIELDS; ++yields) {
+            if (sched_wait(owner, owner_ticket))
+                break;
+            sched_yield();
+        }
+    }
+}
+
+/*
+ * Withdraw the transaction and learn from its outcome
+ */
+void sched_end(thread_ctx_t* ctx, bool committed) {
+    atomic_store_explicit(&(ctx->sched_ticket), 0, memory_order_release);
+    ctx->sched_aborts -= ctx->sched_aborts >> SCHED_HISTORY;
+    if (committed) {
+        ctx->sched_predicted = ctx->sched_writes;
+    }
+    else {
+        ctx->sched_aborts += SCHED_SCALE >> SCHED_HISTORY;
+        ctx->sched_predicted |= ctx->sched_writes;
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "structs.h"
+#include "thread_ctx.h"
+
+/*
+ * Scheduling of writing transactions in tm_begin (tm_config_t.scheduler),
+ * after Shrink: a thread whose transactions keep aborting waits for
+ * transactions it would likely conflict with, instead of starting and
+ * aborting again.
+ *
+ * Fields are summarized in 64-bit signatures, one bit per field picked by a
+ * hash of its address, so signatures intersect if the fields may be the
+ * same. Every thread predicts the next transaction writes what its last one
+ * did, by temporal locality, or what all attempts of an aborting one did
+ * since the last commit, as it will be retried. Writing transaction
+ * publishes its prediction with a ticket, grown by the fields it actually
+ * writes. Tickets order transactions by start.
+ *
+ * Thread with an abort rate of at least SCHED_THRESHOLD then scans the
+ * running transactions, and waits for each one which started earlier and
+ * whose signature intersects its prediction, until its ticket changes or
+ * SCHED_WAIT_YIELDS rounds of SCHED_WAIT_SPINS spins pass, calling
+ * sched_yield between rounds. Waits only go to earlier tickets, so they can
+ * not form cycles, and waiting transactions keep their tickets, so later
+ * ones queue behind them.
+ *
+ * Read-only transactions are neither scheduled nor waited for.
+ */
+
+#define SCHED_SCALE 256             /* Abort rate of a thread that always aborts */
+#define SCHED_HISTORY 3             /* Hyperparameter, log2 of attempts the abort rate is averaged over */
+#define SCHED_THRESHOLD 64          /* Hyperparameter, abort rate (of SCHED_SCALE) from which a thread is scheduled */
+#define SCHED_WAIT_SPINS 256        /* Hyperparameter, spins waiting for one transaction before yielding */
+#define SCHED_WAIT_YIELDS 16        /* Hyperparameter, yields waiting for one transaction before giving up */
+
+void sched_begin(region_t* region, thread_ctx_t* ctx);
+void sched_end(thread_ctx_t* ctx, bool committed);
+
+/*
+ * Bit of the field at given virtual address in signatures
+ */
+static inline uint64_t sched_bit(const void* address) {
+    return UINT64_C(1) << (((uint64_t)(uintptr_t)address * 0x9E3779B97F4A7C15ull) >> 58);
+}
+
+/*
+ * Called before a transaction starts
+ */
+static inline void sched_on_begin(region_t* region, thread_ctx_t* ctx, bool is_ro) {
+    if (unlikely(region->scheduler) && !is_ro)
+        sched_begin(region, ctx);
+}
+
+/*
+ * Transaction writes to given virtual address (first field of the write)
+ */
+static inline void sched_on_write(transaction_t* tx, const void* target) {
+    if (likely(!tx->region->scheduler))
+        return;
+    thread_ctx_t* ctx = tx->ctx;
+    uint64_t bit = sched_bit(target);
+    if (ctx->sched_writes & bit)
+        return;
+    ctx->sched_writes |= bit;
+    atomic_store_explicit(&(ctx->sched_signature), ctx->sched_predicted | ctx->sched_writes, memory_order_relaxed);
+}
+
+/*
+ * Called once the transaction commited or aborted
+ */
+static inline void sched_on_end(transaction_t* tx, bool committed) {
+    if (unlikely(tx->region->scheduler) && !tx->is_ro)
+        sched_end(tx->ctx, committed);
+}
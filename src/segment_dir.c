@@ -0,0 +1,105 @@
+#include <stdlib.h>
+
+#include "segment_dir.h"
+#include "addressing.h"
+#include "structs.h"
+
+int segment_dir_init(segment_dir_t* dir) {
+    dir->released = (uint32_t*)malloc(SEGMENT_DIR_CHUNK * sizeof(uint32_t));
+    if (!dir->released)
+        return INIT_FAIL;
+    dir->released_max = SEGMENT_DIR_CHUNK;
+    atomic_init(&(dir->released_count), 0);
+    pthread_mutex_init(&(dir->released_lock), NULL);
+    for (size_t i = 0; i < SEGMENT_DIR_CHUNKS; ++i)
+        atomic_init(&(dir->chunks[i]), NULL);
+    atomic_init(&(dir->next), 0);
+    return INIT_SUCCESS;
+}
+
+void segment_dir_destroy(segment_dir_t* dir) {
+    for (size_t i = 0; i < SEGMENT_DIR_CHUNKS; ++i)
+        free(atomic_load(&(dir->chunks[i])));
+    pthread_mutex_destroy(&(dir->released_lock));
+    free(dir->released);
+}
+
+/*
+ * Make sure chunk with given index exists
+ *
+ * false if could not allocate
+ */
+static bool segment_dir_ensure_chunk(segment_dir_t* dir, size_t index) {
+    if (atomic_load(&(dir->chunks[index])))
+        return true;
+    segment_slot_t* chunk = (segment_slot_t*)calloc(SEGMENT_DIR_CHUNK, sizeof(segment_slot_t));
+    if (!chunk)
+        return false;
+    segment_slot_t* expected = NULL;
+    if (!atomic_compare_exchange_strong(&(dir->chunks[index]), &expected, chunk))
+        free(chunk); /* Other thread published the chunk first */
+    return true;
+}
+
+/*
+ * Publish descriptor under a new segment number. Descriptor takes the
+ * generation of the number if it was released, see segment_dir_release
+ *
+ * segment number, or -1 if there are no numbers left or could not allocate
+ */
+uint32_t segment_dir_insert(segment_dir_t* dir, segment_descriptor_t* desc) {
+    uint32_t released = (uint32_t)-1;
+    if (atomic_load_explicit(&(dir->released_count), memory_order_relaxed) > 0) {
+        pthread_mutex_lock(&(dir->released_lock));
+        size_t count = atomic_load(&(dir->released_count));
+        if (count > 0) {
+            released = dir->released[count - 1];
+            atomic_store(&(dir->released_count), count - 1);
+        }
+        pthread_mutex_unlock(&(dir->released_lock));
+    }
+    uint32_t segment_num;
+    if (released != (uint32_t)-1) {
+        /* Chunk of a released number exists */
+        segment_num = released & 0xFFFFu;
+        desc->generation = released >> 16;
+        atomic_store_explicit(segment_dir_slot(dir, segment_num), desc, memory_order_release);
+        return segment_num;
+    }
+
+    segment_num = atomic_fetch_add(&(dir->next), 1);
+    if (segment_num >= DEFAULT_SEGMENT_NUM) {
+        /* Last number belongs to the builtin segment */
+        atomic_store(&(dir->next), DEFAULT_SEGMENT_NUM);
+        return -1;
+    }
+    if (!segment_dir_ensure_chunk(dir, segment_num >> SEGMENT_DIR_BITS))
+        return -1;
+    atomic_store_explicit(segment_dir_slot(dir, segment_num), desc, memory_order_release);
+    return segment_num;
+}
+
+/*
+ * Remove segment from the directory, its number can be handed out again,
+ * under given generation, so addresses of the removed segment stay stale.
+ * Caller guarantees that no running transaction can access the segment.
+ */
+void segment_dir_release(segment_dir_t* dir, uint32_t segment_num, uint32_t generation) {
+    atomic_store(segment_dir_slot(dir, segment_num), NULL);
+
+    pthread_mutex_lock(&(dir->released_lock));
+    size_t count = atomic_load(&(dir->released_count));
+    if (count == dir->released_max) {
+        uint32_t* released = (uint32_t*)realloc(dir->released, 2 * dir->released_max * sizeof(uint32_t));
+        if (!released) {
+            /* Number is lost, but the directory stays consistent */
+            pthread_mutex_unlock(&(dir->released_lock));
+            return;
+        }
+        dir->released = released;
+        dir->released_max *= 2;
+    }
+    dir->released[count] = segment_num | (generation & SEGMENT_GENERATION_MASK) << 16;
+    atomic_store(&(dir->released_count), count + 1);
+    pthread_mutex_unlock(&(dir->released_lock));
+}
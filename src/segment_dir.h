@@ -0,0 +1,56 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "macros.h"
+
+#define SEGMENT_DIR_BITS 8                          /* Bits of segment number resolved per level */
+#define SEGMENT_DIR_CHUNK (1u << SEGMENT_DIR_BITS)   /* Slots in one chunk */
+#define SEGMENT_DIR_CHUNKS (1u << SEGMENT_DIR_BITS)  /* Chunks in the directory */
+
+typedef struct segment_descriptor segment_descriptor_t;
+typedef _Atomic(segment_descriptor_t*) segment_slot_t;
+
+/*
+ * Directory of allocated segments indexed by 16 bit segment number. It is a
+ * two level table: the top level is fixed in the region and points to chunks
+ * of slots, which are allocated when first needed and never moved or freed
+ * before the region is destroyed. Readers therefore need no locks, and
+ * inserting never blocks them.
+ */
+struct segment_dir {
+    _Atomic(segment_slot_t*) chunks[SEGMENT_DIR_CHUNKS];
+    atomic_uint next;           /* Smallest segment number never handed out */
+    /* Numbers of destroyed segments, to be handed out again, each with the
+       generation of its next segment in the upper 16 bits. Segments kept
+       for reuse (see segment_pool.h) keep their numbers, so this is rare */
+    pthread_mutex_t released_lock;
+    uint32_t* released;
+    _Atomic(size_t) released_count;
+    size_t released_max;
+};
+typedef struct segment_dir segment_dir_t;
+
+int segment_dir_init(segment_dir_t* dir);
+void segment_dir_destroy(segment_dir_t* dir);
+uint32_t segment_dir_insert(segment_dir_t* dir, segment_descriptor_t* desc);
+void segment_dir_release(segment_dir_t* dir, uint32_t segment_num, uint32_t generation);
+
+/*
+ * Descriptor of segment with given number (two dependent loads)
+ */
+static inline segment_descriptor_t* segment_dir_get(const segment_dir_t* dir, uint32_t segment_num) {
+    segment_slot_t* chunk = atomic_load_explicit(&(dir->chunks[segment_num >> SEGMENT_DIR_BITS]), memory_order_acquire);
+    return atomic_load_explicit(&(chunk[segment_num & (SEGMENT_DIR_CHUNK - 1)]), memory_order_acquire);
+}
+
+/*
+ * Slot of segment with given number, NULL if its chunk was never allocated
+ */
+static inline segment_slot_t* segment_dir_slot(segment_dir_t* dir, uint32_t segment_num) {
+    segment_slot_t* chunk = atomic_load_explicit(&(dir->chunks[segment_num >> SEGMENT_DIR_BITS]), memory_order_acquire);
+    return chunk ? &(chunk[segment_num & (SEGMENT_DIR_CHUNK - 1)]) : NULL;
+}
@@ -0,0 +1,57 @@
+#include <string.h>
+
+#include "segment_pool.h"
+#include "segment_dir.h"
+#include "addressing.h"
+#include "thread_ctx.h"
+#include "mvcc.h"
+#include "direct.h"
+
+/*
+ * Take segment of given size from the pool of the thread, allocating and
+ * publishing new segment if the pool has none of its size class
+ *
+ * NULL if could not allocate
+ */
+segment_descriptor_t* segment_pool_alloc(region_t* region, thread_ctx_t* ctx, size_t size) {
+    size_t size_class = segment_pool_class(size);
+    if (size_class < SEGMENT_POOL_CLASSES && ctx->pool[size_class]) {
+        segment_descriptor_t* desc = ctx->pool[size_class];
+        ctx->pool[size_class] = desc->next_free;
+        ctx->pool_count[size_class]--;
+        /* Data and locks are zero up to the whole capacity: segment_init
+           zeroed it all, and every use writes only within its size, which
+           segment_pool_free zeroes again */
+        desc->size = size;
+        desc->fields = size / desc->align;
+        return desc;
+    }
+    return add_segment(region, size);
+}
+
+/*
+ * Give back segment no running transaction can access. It is zeroed and kept
+ * in the pool of the thread (with its number, under a new generation), or
+ * destroyed if the pool is full.
+ */
+void segment_pool_free(region_t* region, thread_ctx_t* ctx, segment_descriptor_t* desc) {
+    size_t size_class = desc->size_class;
+    mv_segment_clear(ctx, desc);
+    if (size_class >= SEGMENT_POOL_CLASSES || ctx->pool_count[size_class] >= SEGMENT_POOL_DEPTH) {
+        if (region->direct) {
+            direct_segment_release(region, desc);
+            return;
+        }
+        segment_dir_release(&(region->segments), desc->num, desc->generation + 1);
+        segment_destroy(desc);
+        return;
+    }
+
+    memset(desc->data, 0, desc->size);
+    if (desc->vlocks)
+        memset(desc->vlocks, 0, (desc->fields << desc->lock_shift) * sizeof(vlock_t));
+    desc->generation = (desc->generation + 1) & SEGMENT_GENERATION_MASK;
+    desc->next_free = ctx->pool[size_class];
+    ctx->pool[size_class] = desc;
+    ctx->pool_count[size_class]++;
+}
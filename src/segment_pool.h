@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "structs.h"
+
+#define SEGMENT_POOL_GRANULE 256    /* Sizes of classes are multiples of this */
+#define SEGMENT_POOL_CLASSES 257    /* Class 0 is unused, sizes up to 64 KiB are pooled */
+#define SEGMENT_POOL_DEPTH 64       /* Hyperparameter, segments kept per class per thread */
+
+/*
+ * Size class of a segment of given size, SEGMENT_POOL_CLASSES and more for
+ * sizes which are not pooled
+ */
+static inline size_t segment_pool_class(size_t size) {
+    return (size + SEGMENT_POOL_GRANULE - 1) / SEGMENT_POOL_GRANULE;
+}
+
+/*
+ * Bytes allocated for data of a segment of given size. Poolable segments get
+ * whole size class, so they can be reused for any size of the class
+ */
+static inline size_t segment_pool_capacity(size_t size, size_t align) {
+    size_t size_class = segment_pool_class(size);
+    if (size_class < SEGMENT_POOL_CLASSES)
+        return (size_class * SEGMENT_POOL_GRANULE + align - 1) / align * align;
+    return size;
+}
+
+segment_descriptor_t* segment_pool_alloc(region_t* region, thread_ctx_t* ctx, size_t size);
+void segment_pool_free(region_t* region, thread_ctx_t* ctx, segment_descriptor_t* desc);
@@ -0,0 +1,56 @@
+// Requested feature: clock_gettime
+#define _POSIX_C_SOURCE   200809L
+
+#include <string.h>
+#include <time.h>
+
+#include "stats.h"
+#include "profile.h"
+
+uint64_t stats_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+/*
+ * Sum counters of contexts of the current generation
+ */
+void stats_collect(region_t* region, tm_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+#if TM_STATS
+    stats->enabled = true;
+    uint64_t generation = atomic_load_explicit(&(region->stats_generation), memory_order_relaxed);
+    /* Contexts are only prepended, so the list can be walked concurrently */
+    for (thread_ctx_t* ctx = atomic_load(&(region->threads)); ctx; ctx = ctx->next) {
+        struct stats_counters* counters = &(ctx->stats);
+        if (atomic_load_explicit(&(counters->generation), memory_order_acquire) != generation)
+            continue; /* Not counted since the reset */
+        stats->commits += atomic_load_explicit(&(counters->commits), memory_order_relaxed);
+        stats->ro_commits += atomic_load_explicit(&(counters->ro_commits), memory_order_relaxed);
+        for (size_t i = 0; i < TM_ABORT_COUNT; ++i)
+            stats->aborts[i] += atomic_load_explicit(&(counters->aborts[i]), memory_order_relaxed);
+        stats->read_set_entries += atomic_load_explicit(&(counters->read_set_entries), memory_order_relaxed);
+        stats->write_set_entries += atomic_load_explicit(&(counters->write_set_entries), memory_order_relaxed);
+        uint64_t read_max = atomic_load_explicit(&(counters->read_set_max), memory_order_relaxed);
+        uint64_t write_max = atomic_load_explicit(&(counters->write_set_max), memory_order_relaxed);
+        if (read_max > stats->read_set_max)
+            stats->read_set_max = read_max;
+        if (write_max > stats->write_set_max)
+            stats->write_set_max = write_max;
+        for (size_t i = 0; i < TM_STATS_LATENCY_BUCKETS; ++i)
+            stats->commit_latency[i] += atomic_load_explicit(&(counters->commit_latency[i]), memory_order_relaxed);
+    }
+#else
+    (void)region;
+#endif
+}
+
+void stats_reset(region_t* region) {
+#if TM_STATS
+    atomic_fetch_add_explicit(&(region->stats_generation), 1, memory_order_relaxed);
+    profile_reset(region);
+#else
+    (void)region;
+#endif
+}
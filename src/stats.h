@@ -0,0 +1,130 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <tm_ext.h>
+
+#include "structs.h"
+#include "thread_ctx.h"
+#include "norec.h"
+
+/*
+ * Statistics of transactions (tm_stats), compiled only with TM_STATS, every
+ * hook below is empty otherwise.
+ *
+ * Each thread counts in its context (ctx->stats), which only the thread
+ * writes, so counting needs no read-modify-write and threads share no line.
+ * tm_stats sums the contexts of the region on demand. Engines name the
+ * reason of a failure with stats_abort, which tm_abort counts.
+ *
+ * Reset bumps the generation of the region instead of writing counters of
+ * other threads: counts of a context of older generation are taken as
+ * zeros, and the thread clears them itself when it counts next.
+ */
+
+void stats_collect(region_t* region, tm_stats_t* stats);
+void stats_reset(region_t* region);
+uint64_t stats_now(void);
+
+#if TM_STATS
+
+static inline void stats_count(_Atomic(uint64_t)* counter, uint64_t n) {
+    uint64_t value = atomic_load_explicit(counter, memory_order_relaxed);
+    atomic_store_explicit(counter, value + n, memory_order_relaxed);
+}
+
+static inline void stats_max(_Atomic(uint64_t)* counter, uint64_t n) {
+    if (atomic_load_explicit(counter, memory_order_relaxed) < n)
+        atomic_store_explicit(counter, n, memory_order_relaxed);
+}
+
+/*
+ * Counters of the thread, cleared first if the region was reset since
+ */
+static inline struct stats_counters* stats_counters(thread_ctx_t* ctx) {
+    struct stats_counters* counters = &(ctx->stats);
+    uint64_t generation = atomic_load_explicit(&(ctx->region->stats_generation), memory_order_relaxed);
+    if (unlikely(atomic_load_explicit(&(counters->generation), memory_order_relaxed) != generation)) {
+        atomic_store_explicit(&(counters->commits), 0, memory_order_relaxed);
+        atomic_store_explicit(&(counters->ro_commits), 0, memory_order_relaxed);
+        for (size_t i = 0; i < TM_ABORT_COUNT; ++i)
+            atomic_store_explicit(&(counters->aborts[i]), 0, memory_order_relaxed);
+        atomic_store_explicit(&(counters->read_set_entries), 0, memory_order_relaxed);
+        atomic_store_explicit(&(counters->write_set_entries), 0, memory_order_relaxed);
+        atomic_store_explicit(&(counters->read_set_max), 0, memory_order_relaxed);
+        atomic_store_explicit(&(counters->write_set_max), 0, memory_order_relaxed);
+        for (size_t i = 0; i < TM_STATS_LATENCY_BUCKETS; ++i)
+            atomic_store_explicit(&(counters->commit_latency[i]), 0, memory_order_relaxed);
+        /* Readers see the new generation only with cleared counts */
+        atomic_store_explicit(&(counters->generation), generation, memory_order_release);
+    }
+    return counters;
+}
+
+#endif
+
+/*
+ * Remember why the transaction fails, always false so that engines can
+ * return it
+ */
+static inline bool stats_abort(transaction_t* tx, tm_abort_reason_t reason) {
+#if TM_STATS
+    tx->abort_reason = reason;
+#else
+    (void)tx;
+    (void)reason;
+#endif
+    return false;
+}
+
+/*
+ * Time at which tm_end starts, 0 if not collected
+ */
+static inline uint64_t stats_end_start(void) {
+#if TM_STATS
+    return stats_now();
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Called when the transaction aborts, before its descriptor is released
+ */
+static inline void stats_on_abort(transaction_t* tx) {
+#if TM_STATS
+    stats_count(&(stats_counters(tx->ctx)->aborts[tx->abort_reason]), 1);
+#else
+    (void)tx;
+#endif
+}
+
+/*
+ * Called when the transaction commits, before its descriptor is released,
+ * start is what stats_end_start returned
+ */
+static inline void stats_on_commit(transaction_t* tx, uint64_t start) {
+#if TM_STATS
+    struct stats_counters* counters = stats_counters(tx->ctx);
+    uint64_t reads = tx->value_log ? tx->value_log->size : tx->read_set->size;
+    uint64_t writes = tx->is_ro ? 0 : tx->write_set->size;
+    stats_count(&(counters->commits), 1);
+    if (tx->is_ro)
+        stats_count(&(counters->ro_commits), 1);
+    stats_count(&(counters->read_set_entries), reads);
+    stats_count(&(counters->write_set_entries), writes);
+    stats_max(&(counters->read_set_max), reads);
+    stats_max(&(counters->write_set_max), writes);
+
+    uint64_t ns = stats_now() - start;
+    size_t bucket = ns ? 63 - (size_t)__builtin_clzll(ns) : 0;
+    if (bucket >= TM_STATS_LATENCY_BUCKETS)
+        bucket = TM_STATS_LATENCY_BUCKETS - 1;
+    stats_count(&(counters->commit_latency[bucket]), 1);
+#else
+    (void)tx;
+    (void)start;
+#endif
+}
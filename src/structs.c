@@ -6,26 +6,85 @@
 
 #include "structs.h"
 #include "vector.h"
+#include "thread_ctx.h"
+#include "clock.h"
+#include "addressing.h"
+#include "segment_pool.h"
+#include "mvcc.h"
+#include "engine.h"
+#include "norec.h"
+#include "direct.h"
+#include "profile.h"
+#include "trace.h"
 
-const uint32_t garbage_collector_lag = 20;
+static atomic_uint_fast64_t region_ids = 1;
 
-int region_init(region_t* region, size_t size, size_t align) {
+/*
+ * Allocate the first segment of the region, in its own address space if the
+ * region is direct-mapped
+ */
+static int region_init_desc(region_t* region, size_t size, bool direct_mapped) {
+    if (direct_mapped) {
+        if (direct_init(region) != INIT_SUCCESS)
+            return INIT_FAIL;
+        region->desc = direct_segment_alloc(region, size);
+        if (!region->desc) {
+            direct_destroy(region);
+            return INIT_FAIL;
+        }
+        return INIT_SUCCESS;
+    }
     region->desc = (segment_descriptor_t*)malloc(sizeof(segment_descriptor_t));
     if (!region->desc) {
         return INIT_FAIL;
     }
-    region->allocs = vector_init(1024);
-    if (!region->allocs) {
+    if (segment_init(region, region->desc, size) != INIT_SUCCESS) {
         free(region->desc);
         return INIT_FAIL;
     }
-    region->allocs_frees = 0;
+    return INIT_SUCCESS;
+}
+
+int region_init(region_t* region, size_t size, size_t align, const tm_config_t* config) {
+    if (segment_dir_init(&(region->segments)) != INIT_SUCCESS) {
+        return INIT_FAIL;
+    }
+    region->id = atomic_fetch_add(&region_ids, 1);
+    region->threads = NULL;
+    region->thread_count = 0;
+    region->epoch = 0;
+    region->engine = engine_get(config->engine, align);
+    region->cm = config->cm;
+    region->scheduler = config->scheduler;
+    atomic_init(&(region->sched_tickets), 0);
+    region->multi_version = config->multi_version;
     region->align = align;
-    region->global_clock = 0;
-    pthread_mutex_init(&(region->allocs_lock), NULL);
-    if (segment_init(region, region->desc, size) != INIT_SUCCESS) {
-        free(region->desc);
-        vector_destroy(region->allocs);
+    region->lock_shift = config->layout == TM_LAYOUT_PADDED ? PADDED_LOCK_SHIFT : 0;
+    region->direct = NULL;
+    atomic_init(&(region->direct_next), 0);
+#if TM_STATS
+    atomic_init(&(region->stats_generation), 0);
+#endif
+    if (clock_init(region, config->clock) != INIT_SUCCESS) {
+        segment_dir_destroy(&(region->segments));
+        return INIT_FAIL;
+    }
+    if (profile_init(region) != INIT_SUCCESS) {
+        segment_dir_destroy(&(region->segments));
+        clock_destroy(region);
+        return INIT_FAIL;
+    }
+    if (trace_init(region, config->trace) != INIT_SUCCESS) {
+        segment_dir_destroy(&(region->segments));
+        clock_destroy(region);
+        profile_destroy(region);
+        return INIT_FAIL;
+    }
+    if (region_init_desc(region, size, config->direct_mapped) != INIT_SUCCESS) {
+        segment_dir_destroy(&(region->segments));
+        clock_destroy(region);
+        profile_destroy(region);
+        trace_destroy(region);
         return INIT_FAIL;
     }
     return INIT_SUCCESS;
@@ -34,118 +93,179 @@ int region_init(region_t* region, size_t size, size_t align) {
 void region_destroy(region_t* region) {
     /* Specification guarantees that no transaction is running on this tm when
     tm_destroy is called, so we don't have to clean any transactions here. */
+    thread_ctx_region_destroy(region);
 
-    for (size_t i = 0; i < region->allocs->size; ++i) {
-        segment_destroy(region->allocs->data[i]);
+    uint32_t segments = atomic_load(&(region->segments.next));
+    for (uint32_t i = 0; i < segments; ++i) {
+        segment_slot_t* slot = segment_dir_slot(&(region->segments), i);
+        if (slot)
+            segment_destroy(atomic_load(slot));
     }
-    vector_destroy(region->allocs);
-    pthread_mutex_destroy(&(region->allocs_lock));
-    segment_destroy(region->desc);
+    segment_dir_destroy(&(region->segments));
+    if (region->direct)
+        direct_destroy(region); /* Descriptors of its segments are in it */
+    else
+        segment_destroy(region->desc);
+    clock_destroy(region);
+    profile_destroy(region);
+    trace_destroy(region);
     free(region);
 }
 
 int segment_init(region_t* region, segment_descriptor_t* desc, size_t size) {
     size_t align = region->align;
-    if (posix_memalign(&(desc->data), align, size) != 0) {
+    size_t size_class = segment_pool_class(size);
+    size_t capacity = segment_pool_capacity(size, align);
+    if (posix_memalign(&(desc->data), align, capacity) != 0) {
         return INIT_FAIL; 
     }
-    size_t fields = size / align;
-    desc->w_counters = (uint32_t*)malloc(fields * sizeof(uint32_t));
-    if (!desc->w_counters) {
-        free(desc->data);
-        return INIT_FAIL;
+    desc->vlocks = NULL;
+    desc->lock_shift = region->lock_shift;
+    if (region->engine->field_locks) {
+        /* Cache line aligned, so padded locks really are alone in lines */
+        size_t locks_size = ((capacity / align) << desc->lock_shift) * sizeof(vlock_t);
+        if (posix_memalign((void**)&(desc->vlocks), CACHE_LINE_SIZE, locks_size) != 0) {
+            free(desc->data);
+            return INIT_FAIL;
+        }
+        memset(desc->vlocks, 0, locks_size);
     }
-    desc->locks = (atomic_bool*)malloc(fields * sizeof(atomic_bool));
-    if (!desc->locks) {
+    desc->align = align;
+    desc->align_shift = (size_t)__builtin_ctzl(align);
+    desc->offset_mask = SEGMENT_OFFSET_MASK;
+    desc->capacity = capacity;
+    if (mv_segment_init(region, desc) != INIT_SUCCESS) {
         free(desc->data);
-        free(desc->w_counters);
+        free(desc->vlocks);
         return INIT_FAIL;
     }
-    memset(desc->data, 0, size);
-    memset(desc->locks, 0, fields * sizeof(atomic_bool));
-    memset(desc->w_counters, 0, fields * sizeof(uint32_t));
-    desc->align = align;
+    memset(desc->data, 0, capacity);
     desc->size = size;
-    desc->fields = fields;
-    desc->to_delete = false;
+    desc->size_class = size_class;
+    desc->fields = size / align;
+    desc->num = DEFAULT_SEGMENT_NUM;
+    desc->generation = 0;
+    desc->next_free = NULL;
     return INIT_SUCCESS;
 }
 
 void segment_destroy(segment_descriptor_t* desc) {
     if (desc) {
+        mv_segment_destroy(desc);
         free(desc->data);
-        free(desc->w_counters);
-        free(desc->locks);
+        free(desc->vlocks);
         free(desc);
     }
 }
 
-int transaction_init(transaction_t* tx, region_t* region, bool is_ro) {
+/*
+ * Allocate all sets of the descriptor, the same descriptor is later reused
+ * by many (read only or not) transactions of the thread
+ */
+int transaction_init(transaction_t* tx, thread_ctx_t* ctx) {
+    tx->ctx = ctx;
+    tx->next_free = NULL;
+    tx->read_set = read_set_init(READ_SET_DEFAULT_SIZE);
+    if (!tx->read_set) {
+        return INIT_FAIL;
+    }
+    tx->write_set = write_set_init(WRITE_SET_DEFAULT_SIZE);
+    if (!tx->write_set) {
+        read_set_destroy(tx->read_set);
+        return INIT_FAIL;
+    }
+    tx->write_values = arena_init(ARENA_DEFAULT_CHUNK);
+    if (!tx->write_values) {
+        read_set_destroy(tx->read_set);
+        write_set_destroy(tx->write_set);
+        return INIT_FAIL;
+    }
+    tx->allocs = vector_init(VECTOR_DEFAULT_SIZE);
+    if (!tx->allocs) {
+        read_set_destroy(tx->read_set);
+        write_set_destroy(tx->write_set);
+        arena_destroy(tx->write_values);
+        return INIT_FAIL;
+    }
+    tx->frees = vector_init(VECTOR_DEFAULT_SIZE);
+    if (!tx->frees) {
+        read_set_destroy(tx->read_set);
+        write_set_destroy(tx->write_set);
+        arena_destroy(tx->write_values);
+        vector_destroy(tx->allocs);
+        return INIT_FAIL;
+    }
+    tx->value_log = NULL;
+    if (ctx->region->engine->value_log) {
+        tx->value_log = value_log_init(VALUE_LOG_DEFAULT_SIZE);
+        if (!tx->value_log) {
+            read_set_destroy(tx->read_set);
+            write_set_destroy(tx->write_set);
+            arena_destroy(tx->write_values);
+            vector_destroy(tx->allocs);
+            vector_destroy(tx->frees);
+            return INIT_FAIL;
+        }
+    }
+    return INIT_SUCCESS;
+}
+
+/*
+ * Start new transaction on initialized descriptor, sets are emptied but keep
+ * their capacity from previous transactions. Snapshot is taken by the engine.
+ */
+void transaction_begin(transaction_t* tx, region_t* region, bool is_ro) {
     tx->region = region;
     tx->is_ro = is_ro;
-    tx->rv = region->global_clock; /* Sampling global version clock */
+    tx->running = true;
+    tx->read_set->size = 0;
+    tx->allocs->size = 0;
+    tx->frees->size = 0;
+#if TM_STATS
+    tx->abort_reason = TM_ABORT_VALIDATION; /* Every failure names its reason, see stats.h */
+#endif
+    if (tx->value_log)
+        value_log_clear(tx->value_log);
 
     if (!is_ro) {
-        tx->read_set = cvector_init(VECTOR_DEFAULT_SIZE);
-        if (!tx->read_set) {
-            return INIT_FAIL;
-        }
-        tx->write_set_values = vector_init(VECTOR_DEFAULT_SIZE);
-        if (!tx->write_set_values) {
-            cvector_destroy(tx->read_set);
-            return INIT_FAIL;
-        }
-        tx->write_set_targets = vector_init(VECTOR_DEFAULT_SIZE);
-        if (!tx->write_set_targets) {
-            cvector_destroy(tx->read_set);
-            vector_destroy(tx->write_set_values);
-            return INIT_FAIL;
-        }
+        /* Read only transactions never touch the write set */
+        write_set_clear(tx->write_set);
+        arena_reset(tx->write_values);
     }
-    return INIT_SUCCESS;
 }
 
 void transaction_destroy(transaction_t* tx) {
-    if (!(tx->is_ro)) {
-        cvector_destroy(tx->read_set);
-        vector_destroy(tx->write_set_targets);
-        /* Buffers in tx->write_set_values were allocated especially for this transaction */
-        vector_deep_destroy(tx->write_set_values);
-    }
+    read_set_destroy(tx->read_set);
+    write_set_destroy(tx->write_set);
+    /* Value buffers in tx->write_set live in tx->write_values */
+    arena_destroy(tx->write_values);
+    vector_destroy(tx->allocs);
+    vector_destroy(tx->frees);
+    if (tx->value_log)
+        value_log_destroy(tx->value_log);
     free(tx);
 }
 
-uint32_t add_segment(region_t* region, size_t size) {
+/*
+ * Allocate new segment and publish it in the segment directory, or carve it
+ * from the address space if the region is direct-mapped
+ *
+ * NULL if could not allocate
+ */
+segment_descriptor_t* add_segment(region_t* region, size_t size) {
+    if (region->direct)
+        return direct_segment_alloc(region, size);
+
     segment_descriptor_t* segment_ptr = (segment_descriptor_t*)malloc(sizeof(segment_descriptor_t));
     if (!segment_ptr || segment_init(region, segment_ptr, size) != INIT_SUCCESS) {
         free(segment_ptr);
-        return -1;
+        return NULL;
     }
 
-    pthread_mutex_lock(&(region->allocs_lock));
-    uint32_t segment_num = region->allocs->size;
-    vector_push_back(region->allocs, segment_ptr);
-    pthread_mutex_unlock(&(region->allocs_lock));
-
-    return segment_num;
-}
-
-/*
- * Schedules a segment to be deleted. Assumes that allocs_lock is locked by caller
- */
-void schedule_to_delete(region_t* region, segment_descriptor_t* desc) {
-    region->allocs_frees++;
-    desc->to_delete = true;
-}
-
-/*
- * Destroys all segments with flag 'to_delete' set on. Assumes
- * that allocs_lock is locked by caller
- */
-void delete_old_segments(region_t* region) {
-    for (size_t i = 0; i < region->allocs->size; ++i) {
-        segment_descriptor_t* desc = region->allocs->data[i]; 
-        if (desc->to_delete)
-            segment_destroy(desc);
+    segment_ptr->num = segment_dir_insert(&(region->segments), segment_ptr);
+    if (segment_ptr->num == (uint32_t)-1) {
+        segment_destroy(segment_ptr);
+        return NULL;
     }
-}
\ No newline at end of file
+    return segment_ptr;
+}
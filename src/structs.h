@@ -5,34 +5,74 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include <tm_ext.h>
+
 #include "macros.h"
 #include "vector.h"
+#include "read_set.h"
+#include "write_set.h"
+#include "arena.h"
+#include "vlock.h"
+#include "segment_dir.h"
 
 #define INIT_SUCCESS 0
 #define INIT_FAIL 1
 
-#define FREE 0
-#define LOCKED 1
+/* Lock shift of TM_LAYOUT_PADDED, one lock per cache line */
+#define PADDED_LOCK_SHIFT 3
+_Static_assert(sizeof(vlock_t) << PADDED_LOCK_SHIFT == CACHE_LINE_SIZE, "padded lock is not one cache line");
+
 
+typedef struct thread_ctx thread_ctx_t;
+typedef struct clock_partition clock_partition_t;
+typedef struct engine engine_t;
+typedef struct value_log value_log_t;
 
 struct segment_descriptor {
     size_t size;                /* Size in bytes */
+    size_t capacity;            /* Bytes allocated for data, see segment_pool.h */
+    size_t size_class;          /* Size class the capacity was chosen for */
     size_t align;               /* Alginment in segment */
+    size_t align_shift;         /* log2 of align */
+    uint64_t offset_mask;       /* Bits of virtual addresses that are offset in data, see addressing.h */
     size_t fields;              /* Number of fields in the segment (size/align) */
     void* data;                 /* Pointer to tm */
-    atomic_bool* locks;         /* Locks for segment's fiels */
-    uint32_t* w_counters;       /* Local counters of tm fields */
-    bool to_delete;             /* If segment was scheduled for deletion */
+    vlock_t* vlocks;            /* Versioned locks of segment's fields, NULL if engine has none */
+    size_t lock_shift;          /* Lock of field i is vlocks[i << lock_shift], see tm_layout_t */
+    _Atomic(struct mv_node*)* versions; /* Chains of old values of fields, see mvcc.h */
+    uint32_t num;               /* Segment number in virtual addresses */
+    uint32_t generation;        /* Times the number was reused for this segment */
+    struct segment_descriptor* next_free; /* Next segment in the pool of a thread */
 };
 typedef struct segment_descriptor segment_descriptor_t;
 
 struct region {
-    atomic_uint global_clock;
+    /* Written by every (writing) commit, so alone in its cache line */
+    _Alignas(CACHE_LINE_SIZE) _Atomic(uint64_t) global_clock;
+    /* Written by every writing begin of a scheduled region, see scheduler.h */
+    _Alignas(CACHE_LINE_SIZE) _Atomic(uint64_t) sched_tickets;
+    _Alignas(CACHE_LINE_SIZE) uint64_t id; /* Unique among all regions ever created */
+    const engine_t* engine;     /* Algorithm running transactions, see engine.h */
+    tm_clock_t clock_scheme;
+    bool multi_version;         /* Whether fields keep old values, see mvcc.h */
+    _Atomic(tm_cm_t) cm;        /* Contention management policy of tm_atomic */
+    bool scheduler;             /* Whether tm_begin schedules transactions, see scheduler.h */
+    clock_partition_t* clock_partitions; /* Only for TM_CLOCK_PARTITIONED */
     segment_descriptor_t* desc;
-    vector_t* allocs;
-    pthread_mutex_t allocs_lock;
-    uint32_t allocs_frees;
+    segment_dir_t segments;     /* Segments allocated by tm_alloc */
+    segment_descriptor_t* direct; /* Whole address space if direct-mapped, NULL otherwise, see direct.h */
+    _Atomic(uint64_t) direct_next; /* First offset of the address space never carved */
+    _Atomic(uint64_t) epoch;    /* Global epoch of segment reclamation, see epoch.h */
     size_t align;               
+    size_t lock_shift;          /* Of all segments, see segment_descriptor */
+    _Atomic(thread_ctx_t*) threads; /* Contexts of threads using the region */
+    size_t thread_count;        /* Contexts ever registered, guarded by registry lock */
+    char* trace_prefix;         /* Of trace files, NULL if calls are not recorded, see trace.h */
+    uint64_t trace_start;       /* Time the trace started at */
+#if TM_STATS
+    _Atomic(uint64_t) stats_generation; /* Times statistics were reset, see stats.h */
+    struct profile* profile;    /* Fields that caused aborts, see profile.h */
+#endif
 };
 typedef struct region region_t;
 
@@ -41,23 +81,31 @@ typedef struct region region_t;
  */
 struct transaction {
     region_t* region;
+    thread_ctx_t* ctx;              /* Context of the thread owning the descriptor */
+    struct transaction* next_free;  /* Next descriptor in the cache of ctx */
     bool is_ro;
-    uint32_t rv;                    /* Read version of global clock */
-    cvector_t* read_set;            /* Set of locations read by tx in tm */
-    vector_t* write_set_targets;    /* Set of locations writen to by tx in tm */
-    vector_t* write_set_values;     /* Set of locations of values written */
+    bool running;                   /* Between tm_begin and its commit or abort */
+    uint64_t rv;                    /* Read version of global clock */
+    read_set_t* read_set;           /* Locations read by tx in tm, with their versions */
+    write_set_t* write_set;         /* Locations writen to by tx in tm, with their values */
+    arena_t* write_values;          /* Memory for values in write_set */
+    value_log_t* value_log;         /* Values read by tx, only if engine validates by value */
+    vector_t* allocs;               /* Segments allocated by tx, discarded if it aborts */
+    vector_t* frees;                /* Segments freed by tx, retired when it commits */
+#if TM_STATS
+    tm_abort_reason_t abort_reason; /* Set by the engine when it fails, see stats.h */
+#endif
 };
 typedef struct transaction transaction_t;
 
-int region_init(region_t* region, size_t size, size_t align);
+int region_init(region_t* region, size_t size, size_t align, const tm_config_t* config);
 void region_destroy(region_t* region);
 
 int segment_init(region_t* region, segment_descriptor_t* desc, size_t size);
 void segment_destroy(segment_descriptor_t* desc);
 
-int transaction_init(transaction_t* tx, region_t* region, bool is_ro);
+int transaction_init(transaction_t* tx, thread_ctx_t* ctx);
+void transaction_begin(transaction_t* tx, region_t* region, bool is_ro);
 void transaction_destroy(transaction_t* tx);
 
-uint32_t add_segment(region_t* region, size_t size);
-void schedule_to_delete(region_t* region, segment_descriptor_t* desc);
-void delete_old_segments(region_t* region);
+segment_descriptor_t* add_segment(region_t* region, size_t size);
@@ -0,0 +1,186 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "thread_ctx.h"
+#include "epoch.h"
+#include "tl2.h"
+#include "mvcc.h"
+#include "trace.h"
+
+_Thread_local thread_ctx_t* thread_ctx_last = NULL;
+
+/* Contexts of this thread, linked by thread_next */
+static _Thread_local thread_ctx_t* thread_ctxs = NULL;
+
+/* Guards registration and thread_alive/region_alive flags of all contexts */
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t registry_once = PTHREAD_ONCE_INIT;
+static pthread_key_t registry_key;
+
+static void thread_ctx_free(thread_ctx_t* ctx) {
+    epoch_ctx_destroy(ctx);
+    mv_ctx_destroy(ctx);
+    free(ctx);
+}
+
+void thread_ctx_destroy_txs(thread_ctx_t* ctx) {
+    transaction_t* tx = ctx->free_txs;
+    while (tx) {
+        transaction_t* next = tx->next_free;
+        transaction_destroy(tx);
+        tx = next;
+    }
+    ctx->free_txs = NULL;
+}
+
+/*
+ * Called on exit of a thread that registered any context
+ */
+static void thread_ctx_thread_exit(void* head) {
+    pthread_mutex_lock(&registry_lock);
+    thread_ctx_t* ctx = (thread_ctx_t*)head;
+    while (ctx) {
+        thread_ctx_t* next = ctx->thread_next;
+        if (ctx->region_alive) {
+            /* Region still uses the context, it will free it in tm_destroy */
+            thread_ctx_destroy_txs(ctx);
+            ctx->thread_alive = false;
+        }
+        else {
+            thread_ctx_free(ctx);
+        }
+        ctx = next;
+    }
+    pthread_mutex_unlock(&registry_lock);
+}
+
+static void thread_ctx_key_init(void) {
+    pthread_key_create(&registry_key, thread_ctx_thread_exit);
+}
+
+/*
+ * Frees contexts of this thread whose regions were destroyed.
+ * Assumes that registry_lock is locked by caller
+ */
+static void thread_ctx_prune(void) {
+    thread_ctx_t** link = &thread_ctxs;
+    while (*link) {
+        thread_ctx_t* ctx = *link;
+        if (!ctx->region_alive) {
+            *link = ctx->thread_next;
+            if (thread_ctx_last == ctx)
+                thread_ctx_last = NULL;
+            thread_ctx_free(ctx);
+        }
+        else {
+            link = &(ctx->thread_next);
+        }
+    }
+}
+
+/*
+ * Slow path of thread_ctx_get, finds context of this thread among all its
+ * contexts or registers a new one in the region
+ */
+thread_ctx_t* thread_ctx_lookup(region_t* region) {
+    for (thread_ctx_t* ctx = thread_ctxs; ctx; ctx = ctx->thread_next) {
+        if (ctx->region_id == region->id) {
+            thread_ctx_last = ctx;
+            return ctx;
+        }
+    }
+
+    pthread_once(&registry_once, thread_ctx_key_init);
+    thread_ctx_t* ctx = (thread_ctx_t*)aligned_alloc(CACHE_LINE_SIZE, sizeof(thread_ctx_t));
+    if (!ctx)
+        return NULL;
+    if (epoch_ctx_init(ctx) != INIT_SUCCESS) {
+        free(ctx);
+        return NULL;
+    }
+    ctx->region = region;
+    ctx->region_id = region->id;
+    ctx->free_txs = NULL;
+    ctx->trace = NULL;
+    ctx->lock_spins = TL2_LOCK_SPINS_MIN;
+    memset(ctx->pool, 0, sizeof(ctx->pool));
+    memset(ctx->pool_count, 0, sizeof(ctx->pool_count));
+    atomic_init(&(ctx->mv_snapshot), MV_IDLE);
+    atomic_init(&(ctx->mv_versions), 0);
+    ctx->mv_free = NULL;
+    ctx->mv_free_count = 0;
+    ctx->mv_horizon = 0;
+    ctx->mv_commits = 0;
+    atomic_init(&(ctx->cm_priority), 0);
+    atomic_init(&(ctx->sched_ticket), 0);
+    atomic_init(&(ctx->sched_signature), 0);
+    ctx->sched_writes = 0;
+    ctx->sched_predicted = 0;
+    ctx->sched_aborts = 0;
+    for (size_t i = 0; i < TM_CM_COUNT; ++i) {
+        atomic_init(&(ctx->cm_commits[i]), 0);
+        atomic_init(&(ctx->cm_aborts[i]), 0);
+    }
+#if TM_STATS
+    /* No generation of the region, counters are cleared when first used */
+    atomic_init(&(ctx->stats.generation), UINT64_MAX);
+#endif
+    ctx->thread_alive = true;
+    ctx->region_alive = true;
+
+    pthread_mutex_lock(&registry_lock);
+    thread_ctx_prune();
+    ctx->index = region->thread_count++;
+    ctx->seed = 0x9E3779B97F4A7C15ull * (ctx->index + 1);
+    ctx->next = atomic_load(&(region->threads));
+    atomic_store(&(region->threads), ctx);
+    ctx->thread_next = thread_ctxs;
+    thread_ctxs = ctx;
+    pthread_setspecific(registry_key, thread_ctxs);
+    pthread_mutex_unlock(&registry_lock);
+
+    thread_ctx_last = ctx;
+    return ctx;
+}
+
+/*
+ * Detach all contexts from the region which is being destroyed. Specification
+ * guarantees that no transaction is running, so cached descriptors can be
+ * freed here even for threads that are still alive.
+ */
+void thread_ctx_region_destroy(region_t* region) {
+    pthread_mutex_lock(&registry_lock);
+    thread_ctx_t* ctx = atomic_load(&(region->threads));
+    while (ctx) {
+        thread_ctx_t* next = ctx->next;
+        thread_ctx_destroy_txs(ctx);
+        trace_ctx_close(ctx);
+        /* Pooled segments are in the directory, they are destroyed with it */
+        memset(ctx->pool, 0, sizeof(ctx->pool));
+        if (ctx->thread_alive) {
+            /* Thread still links the context, it will free it */
+            ctx->region_alive = false;
+        }
+        else {
+            thread_ctx_free(ctx);
+        }
+        ctx = next;
+    }
+    atomic_store(&(region->threads), NULL);
+    pthread_mutex_unlock(&registry_lock);
+}
+
+/*
+ * Cache of the context is empty, allocate and initialize new descriptor
+ */
+transaction_t* thread_ctx_new_tx(thread_ctx_t* ctx) {
+    transaction_t* tx = (transaction_t*)malloc(sizeof(transaction_t));
+    if (!tx)
+        return NULL;
+    if (transaction_init(tx, ctx) != INIT_SUCCESS) {
+        free(tx);
+        return NULL;
+    }
+    return tx;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "structs.h"
+#include "segment_pool.h"
+
+#define EPOCH_LISTS 3 /* Limbo lists, epochs which may be pending */
+
+/*
+ * Statistics of transactions of one thread, see stats.h. Written by the
+ * thread only, counts are valid if generation is that of the region.
+ */
+struct stats_counters {
+    _Atomic(uint64_t) generation;
+    _Atomic(uint64_t) commits;
+    _Atomic(uint64_t) ro_commits;
+    _Atomic(uint64_t) aborts[TM_ABORT_COUNT];
+    _Atomic(uint64_t) read_set_entries;
+    _Atomic(uint64_t) write_set_entries;
+    _Atomic(uint64_t) read_set_max;
+    _Atomic(uint64_t) write_set_max;
+    _Atomic(uint64_t) commit_latency[TM_STATS_LATENCY_BUCKETS];
+};
+
+/*
+ * State of one thread working on one region. Contexts are registered in the
+ * region on first use and live until both the thread exited and the region
+ * was destroyed, whichever comes last frees the context.
+ */
+struct thread_ctx {
+    /* Written at every tm_begin/tm_end, read by other threads, see epoch.h */
+    _Alignas(CACHE_LINE_SIZE) _Atomic(uint64_t) epoch;
+    _Atomic(uint64_t) mv_snapshot;  /* Read version of running read-only transaction, see mvcc.h */
+    _Atomic(uint64_t) sched_ticket; /* Of running writing transaction, 0 if none, see scheduler.h */
+    _Atomic(uint64_t) sched_signature; /* Fields it is predicted to write */
+    _Alignas(CACHE_LINE_SIZE) region_t* region;
+    uint64_t region_id;             /* Unique id of the region, see region_init */
+    size_t index;                   /* Order of registration in the region */
+    uint64_t seed;                  /* State of xorshift generator, never 0 */
+    uint64_t lock_spins;            /* Limit of spinning on a busy lock at commit, see tl2.c */
+    transaction_t* free_txs;        /* Descriptors ready to be handed out again */
+    vector_t* limbo[EPOCH_LISTS];   /* Segments retired by the thread, per epoch */
+    uint64_t limbo_epoch[EPOCH_LISTS]; /* Epoch of segments in each limbo list */
+    size_t limbo_size;              /* Segments in all limbo lists */
+    segment_descriptor_t* pool[SEGMENT_POOL_CLASSES]; /* Segments for reuse, per size class */
+    uint32_t pool_count[SEGMENT_POOL_CLASSES];
+    vector_t* mv_limbo[EPOCH_LISTS]; /* Lists of old versions cut off by the thread, per epoch */
+    struct mv_node* mv_free;        /* Nodes for old versions ready to be reused */
+    size_t mv_free_count;
+    uint64_t mv_horizon;            /* Oldest snapshot, recomputed every few commits */
+    size_t mv_commits;              /* Commits until the horizon is recomputed */
+    _Atomic(uint64_t) mv_versions;  /* Written by the thread only */
+    _Atomic(uint64_t) cm_priority;  /* Priority of running transaction, see cm.h */
+    _Atomic(uint64_t) cm_commits[TM_CM_COUNT]; /* Written by the thread only */
+    _Atomic(uint64_t) cm_aborts[TM_CM_COUNT];
+    uint64_t sched_writes;          /* Signature of fields written by running transaction */
+    uint64_t sched_predicted;       /* Signature of fields the next transaction should write */
+    uint32_t sched_aborts;          /* Recent abort rate of writing transactions, of SCHED_SCALE */
+    struct trace_writer* trace;     /* File the thread records calls to, see trace.h */
+    struct thread_ctx* next;        /* Next context registered in the region */
+    struct thread_ctx* thread_next; /* Next context of the same thread */
+    bool thread_alive;              /* Guarded by registry lock */
+    bool region_alive;              /* Guarded by registry lock */
+#if TM_STATS
+    /* Last, in lines of their own (the context is padded to a line), as
+       tm_stats reads them while the thread runs */
+    _Alignas(CACHE_LINE_SIZE) struct stats_counters stats;
+#endif
+};
+
+/* Context last used by this thread */
+extern _Thread_local thread_ctx_t* thread_ctx_last;
+
+thread_ctx_t* thread_ctx_lookup(region_t* region);
+void thread_ctx_region_destroy(region_t* region);
+transaction_t* thread_ctx_new_tx(thread_ctx_t* ctx);
+void thread_ctx_destroy_txs(thread_ctx_t* ctx);
+
+/*
+ * Next number of the xorshift generator of the thread
+ */
+static inline uint64_t thread_ctx_random(thread_ctx_t* ctx) {
+    ctx->seed ^= ctx->seed << 13;
+    ctx->seed ^= ctx->seed >> 7;
+    ctx->seed ^= ctx->seed << 17;
+    return ctx->seed;
+}
+
+/*
+ * Context of calling thread for given region, NULL if could not allocate
+ */
+static inline thread_ctx_t* thread_ctx_get(region_t* region) {
+    thread_ctx_t* ctx = thread_ctx_last;
+    if (likely(ctx && ctx->region_id == region->id))
+        return ctx;
+    return thread_ctx_lookup(region);
+}
+
+/*
+ * Take a descriptor from the cache of the context, NULL if could not allocate
+ */
+static inline transaction_t* thread_ctx_acquire_tx(thread_ctx_t* ctx) {
+    transaction_t* tx = ctx->free_txs;
+    if (likely(tx)) {
+        ctx->free_txs = tx->next_free;
+        return tx;
+    }
+    return thread_ctx_new_tx(ctx);
+}
+
+/*
+ * Give descriptor of ended (commited or aborted) transaction back to the cache
+ */
+static inline void thread_ctx_release_tx(transaction_t* tx) {
+    thread_ctx_t* ctx = tx->ctx;
+    tx->next_free = ctx->free_txs;
+    ctx->free_txs = tx;
+}
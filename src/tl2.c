@@ -3,128 +3,138 @@
 
 #include "tl2.h"
 #include "addressing.h"
-
-
-bool tl2_load(transaction_t* tx, segment_descriptor_t* segment, const void* source, void* buffer) {
-    size_t align = segment->align;
-    size_t field = find_field_number(segment, source);
-    size_t set_index = vector_find_last(tx->write_set_targets, source);
-    
-    if (set_index != (size_t)-1) {
-        /* This transaction already written in this field */
-        memcpy(buffer, tx->write_set_values->data[set_index], align);
-    }
-    else {
-        /* This transaction has not written in this field */
-        uint32_t w_count = segment->w_counters[field];
-        void* physical_address = get_physical_address(segment, source);
-        memcpy(buffer, physical_address, align);
-        if (segment->locks[field] == LOCKED || 
-            segment->w_counters[field] > w_count || 
-            segment->w_counters[field] > tx->rv) {
-            return false; /* Read value from older snapshot, abort */
+#include "clock.h"
+#include "cm.h"
+#include "mvcc.h"
+#include "engine.h"
+#include "validate.h"
+#include "stats.h"
+#include "profile.h"
+
+
+bool tl2_validate(transaction_t* tx, const void** conflict) {
+    uint64_t owned_word = vlock_owned_word(tx->ctx);
+    read_set_t* read_set = tx->read_set;
+    size_t i = 0;
+    while ((i += validate_entries(&(read_set->entries[i]), read_set->size - i)) < read_set->size) {
+        /* Kernel stopped at locked or changed field, check it precisely */
+        read_entry_t* entry = &(read_set->entries[i]);
+        uint64_t word = vlock_sample(entry->lock);
+
+        if (word == owned_word) {
+            /* Field locked by this transaction, check version it had before */
+            word = vlock_free_word(write_set_find(tx->write_set, read_set->addresses[i])->version);
         }
-    }
-
-    if (!cvector_push_back(tx->read_set, source))
-        return false; /* Could not add to read_set, abort */
-    return true;
-}
-
-bool tl2_load_ro(transaction_t* tx, segment_descriptor_t* segment, const void* source, void* buffer) {
-    size_t field = find_field_number(segment, source);
-    void* physical_address = get_physical_address(segment, source);
-    memcpy(buffer, physical_address, segment->align);
-
-    if (segment->locks[field] == LOCKED || 
-        segment->w_counters[field] > tx->rv) {
-        return false; /* Read value from older snapshot, abort */
+        if (word != vlock_free_word(entry->version)) {
+            /* Addresses of reads of read-only transactions are not kept */
+            if (!tx->is_ro)
+                *conflict = read_set->addresses[i];
+            return false; /* Field was written (or is being written) since */
+        }
+        ++i;
     }
     return true;
 }
 
-bool tl2_put(transaction_t* tx, segment_descriptor_t* segment, const void* source, void* const target) {
-    size_t align = segment->align;
-    void* buffer = malloc(align);
-    if (!buffer)
-        return false; /* Could not allocate buffer, abort */
-    memcpy(buffer, source, align);
-
-    if (!vector_push_back(tx->write_set_targets, target) ||
-        !vector_push_back(tx->write_set_values, buffer)) {
-        free(buffer);
+bool tl2_extend(transaction_t* tx, uint64_t version, const void** conflict) {
+    uint64_t now = clock_sample(tx->region);
+    if (now < version)
+        now = clock_catch_up(tx->region, version);
+    if (now == tx->rv)
+        return false; /* Nothing commited since, snapshot can not move */
+    if (!tl2_validate(tx, conflict))
         return false;
-    }
+    /* Commits with version up to now locked their fields before they took
+       the version, so whatever they wrote and we read was checked above */
+    tx->rv = now;
     return true;
 }
 
-void free_locks(vector_t* locations, region_t* region, size_t n) {
-    bool desired_lock_state;
+/* Fields ahead of the current one to prefetch, hyperparameter */
+#define TL2_PREFETCH_DISTANCE 8
+
+/*
+ * Unlock first n fields of the write set, restoring their old versions
+ */
+void free_locks(write_set_t* write_set, size_t n) {
     for (size_t i = 0; i < n; ++i) {
-        segment_descriptor_t* segment = find_segment(region, locations->data[i]); 
-        size_t field = find_field_number(segment, locations->data[i]);
-        desired_lock_state = LOCKED;
-        if (!atomic_compare_exchange_strong(&(segment->locks[field]), &desired_lock_state, FREE)) {
-            /* This lock was supposed to be locked, but its free, which is weird
-               but doesnt break anything. */
-            continue;
-        }
+        write_entry_t* entry = &(write_set->entries[i]);
+        vlock_unlock(entry->lock, entry->version);
     }
 }
 
-bool tl2_end(transaction_t* tx) {
-    region_t* region = tx->region;
-
-    /* We don't want to lock a field two times, so we need to remove duplicates */
-    vector_t* write_set_targets_copy = vector_no_duplicates(tx->write_set_targets);
-    if (!write_set_targets_copy)
-        return NULL; /* Could not allocate, abort */
-
-    /* Acquire locks in any order */        // TODO maybe more then one loop?
-    bool desired_lock_state;
-    for (size_t i = 0; i < write_set_targets_copy->size; ++i) {
-        segment_descriptor_t* segment = find_segment(region, write_set_targets_copy->data[i]); 
-        size_t field = find_field_number(segment, write_set_targets_copy->data[i]);
-        desired_lock_state = FREE;
-        if (!atomic_compare_exchange_strong(&(segment->locks[field]), &desired_lock_state, LOCKED)) {
-            /* Lock is locked, abort */
-            free_locks(write_set_targets_copy, region, i);
-            return false;
+/*
+ * Lock the field of given entry for commit. Busy lock is waited for with
+ * bounded spinning, whose limit adapts to how long locks of the region were
+ * recently held: it grows when waiting paid off and shrinks when it did not.
+ *
+ * False if the lock could not be taken
+ */
+static bool tl2_lock(transaction_t* tx, write_entry_t* entry) {
+    thread_ctx_t* ctx = tx->ctx;
+    uint64_t word = vlock_sample(entry->lock);
+    for (size_t attempt = 0; attempt < TL2_LOCK_ATTEMPTS; ++attempt) {
+        if (vlock_is_locked(word)) {
+            if (vlock_wait(entry->lock, &word, ctx->lock_spins)) {
+                if (ctx->lock_spins < TL2_LOCK_SPINS_MAX)
+                    ctx->lock_spins <<= 1;
+            }
+            else {
+                if (ctx->lock_spins > TL2_LOCK_SPINS_MIN)
+                    ctx->lock_spins >>= 1;
+                if (!cm_wait_lock(ctx, entry->lock, &word))
+                    return false;
+            }
         }
-    }
-    vector_destroy(write_set_targets_copy);
-
-    /* Increment global version clock */
-    uint32_t wv = atomic_fetch_add(&(region->global_clock), 1) + 1;
-    
-    /* Validate the read set */
-    for (size_t i = 0; i < tx->read_set->size; ++i) {
-        segment_descriptor_t* segment = find_segment(tx->region, tx->read_set->data[i]); 
-        size_t field = find_field_number(segment, tx->read_set->data[i]);
-        bool field_written = vector_find_last(
-            tx->write_set_targets, tx->read_set->data[i]) != (size_t)-1;
-
-        if ((!field_written && segment->locks[field] == LOCKED) || 
-            segment->w_counters[field] > tx->rv) {
-            /* Read value no longer valid, abort */
-            free_locks(tx->write_set_targets, region, tx->write_set_targets->size);
-            return false;
+        if (vlock_try_lock(entry->lock, word, ctx)) {
+            entry->version = vlock_version(word);
+            return true;
         }
+        /* Another committer took the lock first */
+        word = vlock_sample(entry->lock);
     }
+    return false;
+}
 
-    /* Write new values and increase w_count */
-    for (size_t i = 0; i < tx->write_set_targets->size; ++i) {
-        segment_descriptor_t* segment = find_segment(tx->region, tx->write_set_targets->data[i]); 
-        size_t field = find_field_number(segment, tx->write_set_targets->data[i]);
+static void tl2_begin(transaction_t* tx) {
+    /* Sampling global version clock, read-only transactions of multi-version
+       regions announce it as their snapshot */
+    region_t* region = tx->region;
+    if (tx->is_ro && region->multi_version)
+        tx->rv = mv_snapshot_begin(region, tx->ctx);
+    else
+        tx->rv = clock_sample(region);
+}
 
-        void* physical_address = get_physical_address(segment, tx->write_set_targets->data[i]);
-        memcpy(physical_address, tx->write_set_values->data[i], region->align);
-        segment->w_counters[field] = wv; /* Increasing w_count */
-    }
+/*
+ * Copy 8 byte field of shared memory in one access, that cannot be torn by
+ * concurrent writers. Private side may be unaligned.
+ */
+static inline void tl2_word_load(void* buffer, const void* data) {
+    uint64_t word = __atomic_load_n((const uint64_t*)data, __ATOMIC_RELAXED);
+    memcpy(buffer, &word, sizeof(word));
+}
 
-    /* Free the locks */
-    free_locks(tx->write_set_targets, region, tx->write_set_targets->size);
-    
-    /* Commit */
-    return true;
+static inline void tl2_word_store(void* data, const void* value) {
+    uint64_t word;
+    memcpy(&word, value, sizeof(word));
+    __atomic_store_n((uint64_t*)data, word, __ATOMIC_RELAXED);
 }
+
+/* Generic instance, for any alignment (tl2_engine) */
+#define TL2_ALIGN 0
+#define TL2_SPEC(name) name
+#define TL2_LINKAGE
+#include "tl2_spec.h"
+#undef TL2_ALIGN
+#undef TL2_SPEC
+#undef TL2_LINKAGE
+
+/* Instance for 8 byte words, the common alignment (tl2_engine_8) */
+#define TL2_ALIGN 8
+#define TL2_SPEC(name) name##_8
+#define TL2_LINKAGE static
+#include "tl2_spec.h"
+#undef TL2_ALIGN
+#undef TL2_SPEC
+#undef TL2_LINKAGE
@@ -1,6 +1,34 @@
 #pragma once
 
 #include "structs.h"
+#include "addressing.h"
+
+#define TL2_LOCK_SPINS_MIN 16   /* Hyperparameter, bounds of spinning on a busy lock at commit */
+#define TL2_LOCK_SPINS_MAX 4096
+#define TL2_LOCK_ATTEMPTS 4     /* Hyperparameter, lost races for a lock before abort */
+#define TL2_EXTEND_ATTEMPTS 4   /* Hyperparameter, snapshot extensions in one read */
+
+/*
+ * Check that every field in the read set still has the version it was read
+ * with. Fields locked by the transaction itself are checked against the
+ * version they had before it locked them (kept in the write set). Address
+ * of the first field that changed is stored to conflict, unless the
+ * transaction is read-only (which keeps no addresses).
+ *
+ * true if all reads are still valid
+ */
+bool tl2_validate(transaction_t* tx, const void** conflict);
+
+/*
+ * Extend snapshot of the transaction (LSA style): sample the clock again and
+ * advance tx->rv to it, if every field in the read set still has the version
+ * it was read with. Version is that of the field which needs the extension,
+ * moved into the clock if it ran ahead of it, see clock_catch_up. Field
+ * which failed validation is stored to conflict, see tl2_validate.
+ *
+ * true for success, false if the snapshot could not be extended
+ */
+bool tl2_extend(transaction_t* tx, uint64_t version, const void** conflict);
 
 /*
  * load exactly 'segment->align' bytes from source (tm) (or write set) to buffer (lm)
@@ -12,16 +40,19 @@
 bool tl2_load(transaction_t* tx, segment_descriptor_t* segment, const void* source, void* buffer);
 
 /*
- * load exactly 'segment->align' bytes from source (tm) to buffer (lm)
- * dont put address to read_set as this is part of read only transaction!
+ * load 'size' bytes (multiple of 'segment->align') from source (tm) directly
+ * to target (lm), validating all fields at once
+ * fields go to read_set with their locks and versions, so that the snapshot can be
+ * extended, see tl2_extend
  *
  * true for success, false to abort
  */
-bool tl2_load_ro(transaction_t* tx, segment_descriptor_t* segment, const void* source, void* buffer);
+bool tl2_read_ro(transaction_t* tx, segment_descriptor_t* segment, const void* source, size_t size, void* target);
 
 /* 
  * We were supposed to put exactly 'segment->align' bytes from source (lm) 
- * to target, we don't do that, we put it to created buffer (added to tx->write_set_values)
+ * to target, we don't do that, we put it to buffer in tx->write_set (memory
+ * for it is taken from tx->write_values)
  *
  * true for success, falst to aborts
  */
@@ -0,0 +1,236 @@
+/*
+ * Template of the TL2 engine, included by tl2.c once per instance (no include
+ * guard). The includer defines:
+ *
+ *   TL2_ALIGN      alignment the instance is specialized for, 0 for any
+ *   TL2_SPEC(name) name of a function or engine of the instance
+ *   TL2_LINKAGE    linkage of the functions (empty or static)
+ *
+ * Specialized instance knows size of a field at compile time: field numbers
+ * are shifts by a constant and fields of shared memory are single 64-bit
+ * accesses instead of memcpy calls. Everything is undefined at the end.
+ */
+
+#if TL2_ALIGN
+#define TL2_FIELD_SIZE(segment) ((size_t)TL2_ALIGN)
+#define TL2_FIELD_NUMBER(segment, address) \
+    ((size_t)(segment_offset((segment), (address)) >> __builtin_ctz(TL2_ALIGN)))
+#define TL2_LOAD_FIELD(buffer, data, size) ((void)(size), tl2_word_load((buffer), (data)))
+#define TL2_STORE_FIELD(data, value, size) ((void)(size), tl2_word_store((data), (value)))
+#else
+#define TL2_FIELD_SIZE(segment) ((segment)->align)
+#define TL2_FIELD_NUMBER(segment, address) find_field_number((segment), (address))
+#define TL2_LOAD_FIELD(buffer, data, size) memcpy((buffer), (data), (size))
+#define TL2_STORE_FIELD(data, value, size) memcpy((data), (value), (size))
+#endif
+
+TL2_LINKAGE bool TL2_SPEC(tl2_load)(transaction_t* tx, segment_descriptor_t* segment, const void* source, void* buffer) {
+    size_t align = TL2_FIELD_SIZE(segment);
+    write_entry_t* entry = write_set_find(tx->write_set, source);
+
+    if (entry) {
+        /* This transaction already written in this field, the read does not
+           depend on other transactions */
+        memcpy(buffer, entry->value, align);
+        return true;
+    }
+
+    /* This transaction has not written in this field */
+    vlock_t* lock = get_field_lock(segment, TL2_FIELD_NUMBER(segment, source));
+    void* physical_address = get_physical_address(segment, source);
+    uint64_t word;
+    for (size_t attempt = 0;; ++attempt) {
+        word = vlock_sample(lock);
+        TL2_LOAD_FIELD(buffer, physical_address, align);
+        if (vlock_is_locked(word) || vlock_resample(lock) != word) {
+            profile_conflict(tx, source);
+            return stats_abort(tx, TM_ABORT_LOCKED); /* Field is being written, abort */
+        }
+        if (vlock_version(word) <= tx->rv)
+            break;
+        /* Field is newer than the snapshot, try to move the snapshot past it */
+        const void* conflict = source; /* Unless a field read before changed */
+        if (attempt == TL2_EXTEND_ATTEMPTS || !tl2_extend(tx, vlock_version(word), &conflict)) {
+            profile_conflict(tx, conflict);
+            return stats_abort(tx, TM_ABORT_SNAPSHOT); /* Read value from older snapshot, abort */
+        }
+    }
+
+    if (!read_set_push(tx->read_set, lock, source, vlock_version(word)))
+        return stats_abort(tx, TM_ABORT_VALIDATION); /* Read stale before (or could not add to read_set), abort */
+    return true;
+}
+
+TL2_LINKAGE bool TL2_SPEC(tl2_read_ro)(transaction_t* tx, segment_descriptor_t* segment, const void* source, size_t size, void* target) {
+    size_t align = TL2_FIELD_SIZE(segment);
+    size_t fields = size / align;
+    vlock_t* locks = get_field_lock(segment, TL2_FIELD_NUMBER(segment, source));
+    size_t shift = segment->lock_shift;
+    const char* data = get_physical_address(segment, source);
+
+    /* Versions are recorded, so the snapshot can be extended by later reads */
+    read_set_t* read_set = tx->read_set;
+    if (!read_set_reserve(read_set, fields))
+        return stats_abort(tx, TM_ABORT_NOMEM); /* Could not add to read_set, abort */
+    read_entry_t* entries = &(read_set->entries[read_set->size]);
+
+    for (size_t attempt = 0;; ++attempt) {
+        uint64_t rv = tx->rv;
+        bool valid = true;
+        size_t last = 0;            /* Last field checked, the newer one if not valid */
+
+        /* Every field has to be free and old enough before the copy ... */
+        for (size_t i = 0; i < fields && valid; ++i) {
+            __builtin_prefetch(&(locks[(i + TL2_PREFETCH_DISTANCE) << shift]));
+            __builtin_prefetch(data + (i + TL2_PREFETCH_DISTANCE) * align);
+            uint64_t word = vlock_sample(&(locks[i << shift]));
+            if (vlock_is_locked(word)) {
+                profile_conflict(tx, (const char*)source + i * align);
+                return stats_abort(tx, TM_ABORT_LOCKED); /* Field is being written, abort */
+            }
+            entries[i].lock = &(locks[i << shift]);
+            entries[i].version = vlock_version(word);
+            valid = entries[i].version <= rv;
+            last = i;
+        }
+
+        if (valid) {
+            memcpy(target, data, size);
+            atomic_thread_fence(memory_order_acquire);
+
+            /* ... and unchanged after it. Writer that could change a field in
+               between and still publish version <= rv would have held its
+               lock before the first pass. */
+            for (size_t i = 0; i < fields && valid; ++i) {
+                uint64_t word = atomic_load_explicit(&(locks[i << shift]), memory_order_relaxed);
+                valid = word == vlock_free_word(entries[i].version);
+                last = i;
+            }
+            if (valid)
+                return read_set_append(read_set, fields) || stats_abort(tx, TM_ABORT_VALIDATION);
+        }
+
+        /* Some field is newer than the snapshot, try to move the snapshot */
+        const void* conflict = (const char*)source + last * align;
+        if (attempt == TL2_EXTEND_ATTEMPTS || !tl2_extend(tx, entries[last].version, &conflict)) {
+            profile_conflict(tx, conflict);
+            return stats_abort(tx, TM_ABORT_SNAPSHOT); /* Read value from older snapshot, abort */
+        }
+    }
+}
+
+TL2_LINKAGE bool TL2_SPEC(tl2_put)(transaction_t* tx, segment_descriptor_t* segment, const void* source, void* const target) {
+    size_t align = TL2_FIELD_SIZE(segment);
+    bool inserted;
+    write_entry_t* entry = write_set_insert(tx->write_set, target, &inserted);
+    if (!entry)
+        return stats_abort(tx, TM_ABORT_NOMEM); /* Could not add to write_set, abort */
+
+    if (inserted) {
+        entry->value = arena_alloc(tx->write_values, align);
+        if (!entry->value) {
+            /* Drop the half built entry, it is the last one */
+            write_set_drop_last(tx->write_set);
+            return stats_abort(tx, TM_ABORT_NOMEM); /* Could not allocate buffer, abort */
+        }
+        size_t field = TL2_FIELD_NUMBER(segment, target);
+        entry->data = get_physical_address(segment, target);
+        entry->lock = get_field_lock(segment, field);
+        entry->chain = segment->versions ? &(segment->versions[field]) : NULL;
+    }
+    /* Repeated writes to the same field overwrite the buffered value */
+    memcpy(entry->value, source, align);
+    return true;
+}
+
+TL2_LINKAGE bool TL2_SPEC(tl2_end)(transaction_t* tx) {
+    if (tx->is_ro) {
+        /* No read_set validation is needed, commit */
+        return true;
+    }
+    region_t* region = tx->region;
+    write_set_t* write_set = tx->write_set;
+
+    /* Write set holds every field only once, so no field is locked two times.
+       All committers lock in the same global order (segment number, then
+       field), so spinning on a busy lock can not deadlock. */
+    write_set_sort(write_set);
+    for (size_t i = 0; i < write_set->size; ++i) {
+        if (!tl2_lock(tx, &(write_set->entries[i]))) {
+            /* Lock is still locked, abort */
+            profile_conflict(tx, write_set->entries[i].target);
+            free_locks(write_set, i);
+            return stats_abort(tx, TM_ABORT_LOCK);
+        }
+    }
+
+    /* Get write version from global version clock */
+    uint64_t wv = clock_commit(region, tx->ctx);
+
+    /* Validate the read set */
+    const void* conflict;
+    if (!tl2_validate(tx, &conflict)) {
+        /* Read value no longer valid, abort */
+        profile_conflict(tx, conflict);
+        free_locks(write_set, write_set->size);
+        return stats_abort(tx, TM_ABORT_VALIDATION);
+    }
+
+    if (region->multi_version && !mv_prepare(tx)) {
+        /* Could not allocate nodes for old values, abort */
+        free_locks(write_set, write_set->size);
+        return stats_abort(tx, TM_ABORT_NOMEM);
+    }
+
+    /* Write new values and publish them with new version */
+    size_t align = TL2_FIELD_SIZE(region);
+    for (size_t i = 0; i < write_set->size; ++i) {
+        write_entry_t* entry = &(write_set->entries[i]);
+        if (region->multi_version)
+            mv_publish(tx, entry);
+        TL2_STORE_FIELD(entry->data, entry->value, align);
+        vlock_unlock(entry->lock, wv);
+    }
+
+    /* Commit */
+    return true;
+}
+
+static bool TL2_SPEC(tl2_read)(transaction_t* tx, segment_descriptor_t* segment, const void* source, size_t size, void* target) {
+    if (tx->is_ro) {
+        if (tx->region->multi_version)
+            return mv_read(tx, segment, source, size, target) || stats_abort(tx, TM_ABORT_SNAPSHOT);
+        return TL2_SPEC(tl2_read_ro)(tx, segment, source, size, target);
+    }
+
+    size_t align = TL2_FIELD_SIZE(segment);
+    for (size_t offset = 0; offset < size; offset += align) {
+        if (!TL2_SPEC(tl2_load)(tx, segment, (const char*)source + offset, (char*)target + offset))
+            return false;
+    }
+    return true;
+}
+
+static bool TL2_SPEC(tl2_write)(transaction_t* tx, segment_descriptor_t* segment, const void* source, size_t size, void* target) {
+    size_t align = TL2_FIELD_SIZE(segment);
+    for (size_t offset = 0; offset < size; offset += align) {
+        if (!TL2_SPEC(tl2_put)(tx, segment, (const char*)source + offset, (char*)target + offset))
+            return false;
+    }
+    return true;
+}
+
+const engine_t TL2_SPEC(tl2_engine) = {
+    .begin = tl2_begin,
+    .read = TL2_SPEC(tl2_read),
+    .write = TL2_SPEC(tl2_write),
+    .end = TL2_SPEC(tl2_end),
+    .abort = NULL,
+    .field_locks = true,
+    .value_log = false,
+};
+
+#undef TL2_FIELD_SIZE
+#undef TL2_FIELD_NUMBER
+#undef TL2_LOAD_FIELD
+#undef TL2_STORE_FIELD
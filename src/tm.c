@@ -6,19 +6,67 @@
 
 // Internal headers
 #include <tm.h>
+#include <tm_ext.h>
 
 #include "structs.h"
 #include "macros.h"
-#include "tl2.h"
+#include "engine.h"
 #include "addressing.h"
+#include "thread_ctx.h"
+#include "clock.h"
+#include "epoch.h"
+#include "segment_pool.h"
+#include "cm.h"
+#include "mvcc.h"
+#include "stats.h"
+#include "profile.h"
+#include "trace.h"
+#include "scheduler.h"
 
 
+void tm_config_default(tm_config_t* config) {
+    config->engine = TM_ENGINE_TL2;
+    config->clock = TM_CLOCK_GV1;
+    config->cm = TM_CM_IMMEDIATE;
+    config->layout = TM_LAYOUT_PACKED;
+    config->multi_version = false;
+    config->direct_mapped = false;
+    config->scheduler = false;
+    config->trace = getenv("TM_TRACE");
+}
+
 shared_t tm_create(size_t size, size_t align) {
-    region_t* region = (region_t*) malloc(sizeof(region_t));
+    return tm_create_ext(size, align, NULL);
+}
+
+shared_t tm_create_ext(size_t size, size_t align, tm_config_t const* config) {
+    tm_config_t default_config;
+    if (!config) {
+        tm_config_default(&default_config);
+        config = &default_config;
+    }
+    if (config->engine >= TM_ENGINE_COUNT || config->clock >= TM_CLOCK_COUNT || 
+        config->cm >= TM_CM_COUNT || config->layout >= TM_LAYOUT_COUNT || size > SEGMENT_MAX_SIZE) {
+        return invalid_shared;
+    }
+    if (config->engine == TM_ENGINE_NOREC && config->clock != TM_CLOCK_GV1) {
+        /* Clock of NOrec is its sequence lock */
+        return invalid_shared;
+    }
+    if (config->engine != TM_ENGINE_TL2 && config->multi_version) {
+        /* Old values are saved at TL2 write back */
+        return invalid_shared;
+    }
+    if (config->direct_mapped && config->multi_version) {
+        /* Chains of old values are kept per segment, not per address space */
+        return invalid_shared;
+    }
+
+    region_t* region = (region_t*) aligned_alloc(CACHE_LINE_SIZE, sizeof(region_t));
     if (unlikely(!region)) {
         return invalid_shared;
     }
-    if (region_init(region, size, align) != INIT_SUCCESS) {
+    if (region_init(region, size, align, config) != INIT_SUCCESS) {
         free(region);
         return invalid_shared;
     }
@@ -30,8 +78,9 @@ void tm_destroy(shared_t shared) {
     region_destroy(region);
 }
 
-void* tm_start(shared_t unused(shared)) {
-    return build_virtual_address(DEFAULT_SEGMENT_NUM, 0);
+void* tm_start(shared_t shared) {
+    region_t* region = (region_t*) shared;
+    return segment_address(region, region->desc);
 }
 
 size_t tm_size(shared_t shared) {
@@ -44,103 +93,214 @@ size_t tm_align(shared_t shared) {
     return region->align;
 }
 
+/*
+ * Abort given transaction, its descriptor goes back to the cache
+ */
+static void tm_abort(transaction_t* tx) {
+    region_t* region = tx->region;
+    tx->running = false;
+    stats_on_abort(tx);
+    sched_on_end(tx, false);
+    if (region->engine->abort)
+        region->engine->abort(tx);
+    /* No other transaction could learn addresses of segments allocated by tx */
+    for (size_t i = 0; i < tx->allocs->size; ++i)
+        segment_pool_free(region, tx->ctx, tx->allocs->data[i]);
+    if (tx->is_ro && region->multi_version)
+        mv_snapshot_end(tx->ctx);
+    epoch_exit(tx->ctx);
+    clock_abort(region, tx->rv);
+    thread_ctx_release_tx(tx);
+}
+
+/*
+ * Commit given transaction, its descriptor goes back to the cache
+ */
+static void tm_commit(transaction_t* tx) {
+    tx->running = false;
+    sched_on_end(tx, true);
+    if (tx->is_ro && tx->region->multi_version)
+        mv_snapshot_end(tx->ctx);
+    epoch_exit(tx->ctx);
+    for (size_t i = 0; i < tx->frees->size; ++i)
+        epoch_retire(tx->region, tx->ctx, tx->frees->data[i]);
+    thread_ctx_release_tx(tx);
+}
+
 tx_t tm_begin(shared_t shared, bool is_ro) {
-    transaction_t* tx = malloc(sizeof(transaction_t));
     region_t* region = (region_t*) shared;
-    if (unlikely(transaction_init(tx, region, is_ro)) != INIT_SUCCESS) {
-        free(tx);
+    thread_ctx_t* ctx = thread_ctx_get(region);
+    if (unlikely(!ctx)) {
+        return invalid_tx;
+    }
+    transaction_t* tx = thread_ctx_acquire_tx(ctx);
+    if (unlikely(!tx)) {
         return invalid_tx;
     }
-    
+    /* Before the snapshot is taken, waiting makes it older for nothing */
+    sched_on_begin(region, ctx, is_ro);
+    epoch_enter(region, ctx);
+    transaction_begin(tx, region, is_ro);
+    region->engine->begin(tx);
+    trace_call(region, ctx, TRACE_BEGIN, NULL, 0, is_ro, NULL);
     return (tx_t)tx;
 }
 
-bool tm_end(shared_t unused(shared), tx_t tx) {
-    if (((transaction_t*)tx)->is_ro) { 
-        /* No read_set validation is needed, commit */
-        transaction_destroy((transaction_t*)tx);
-        return true;
-    }
-    if (!tl2_end((transaction_t*)tx)) {
+bool tm_end(shared_t shared, tx_t tx) {
+    region_t* region = (region_t*) shared;
+    thread_ctx_t* ctx = ((transaction_t*)tx)->ctx;
+    uint64_t start = stats_end_start();
+    if (!region->engine->end((transaction_t*)tx)) {
         /* Transaction should be aborted */
-        transaction_destroy((transaction_t*)tx);
+        tm_abort((transaction_t*)tx);
+        trace_call(region, ctx, TRACE_END, NULL, 0, false, NULL);
         return false;
     }
-    transaction_destroy((transaction_t*)tx);
+    stats_on_commit((transaction_t*)tx, start);
+    tm_commit((transaction_t*)tx);
+    trace_call(region, ctx, TRACE_END, NULL, 0, true, NULL);
     return true;
 }
 
+/*
+ * Whether the address was in a live segment, a stale one aborts the
+ * transaction, see find_segment
+ */
+static inline bool tm_segment_found(transaction_t* tx, segment_descriptor_t* segment) {
+    return likely(segment) || stats_abort(tx, TM_ABORT_SEGMENT);
+}
+
 bool tm_read(shared_t shared, tx_t tx, void const* source, size_t size, void* target) { 
     region_t* region = (region_t*) shared;
     segment_descriptor_t* segment = find_segment(region, source);
 
-    void* buffer = malloc(size * sizeof(void));
-    for (size_t field = 0; field < size / region->align; field++) {
-        if (((transaction_t*)tx)->is_ro) {
-            if (!tl2_load_ro((transaction_t*)tx, segment, 
-                             source + field * region->align, 
-                             buffer + field * region->align)) {
-                /* Transaction should be aborted */
-                transaction_destroy((transaction_t*)tx);
-                free(buffer);
-                return false;
-            }
-        }
-        else {
-            if (!tl2_load((transaction_t*)tx, segment, 
-                          source + field * region->align, 
-                          buffer + field * region->align)) {
-                /* Transaction should be aborted */
-                transaction_destroy((transaction_t*)tx);
-                free(buffer);
-                return false;
-            }
-        }
+    if (!tm_segment_found((transaction_t*)tx, segment) ||
+        !region->engine->read((transaction_t*)tx, segment, source, size, target)) {
+        /* Transaction should be aborted */
+        tm_abort((transaction_t*)tx);
+        trace_call(region, ((transaction_t*)tx)->ctx, TRACE_READ, source, size, false, NULL);
+        return false;
     }
-    memcpy(target, buffer, size);
-    free(buffer);
+    trace_call(region, ((transaction_t*)tx)->ctx, TRACE_READ, source, size, true, NULL);
     return true;
 }
 
-bool tm_write(shared_t unused(shared), tx_t tx, void const* source, size_t size, void* target) {
+bool tm_write(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
     region_t* region = (region_t*) shared;
     segment_descriptor_t* segment = find_segment(region, target);
-    
-    for (size_t field = 0; field < size / region->align; field++) {
-        if (!tl2_put((transaction_t*)tx, segment,
-                     source + field * region->align,
-                     target + field * region->align)) {
-            /* Transaction should be aborted */
-            transaction_destroy((transaction_t*)tx);
-            return false;
-        }
+
+    sched_on_write((transaction_t*)tx, target);
+    if (!tm_segment_found((transaction_t*)tx, segment) ||
+        !region->engine->write((transaction_t*)tx, segment, source, size, target)) {
+        /* Transaction should be aborted */
+        tm_abort((transaction_t*)tx);
+        trace_call(region, ((transaction_t*)tx)->ctx, TRACE_WRITE, target, size, false, source);
+        return false;
     }
+    trace_call(region, ((transaction_t*)tx)->ctx, TRACE_WRITE, target, size, true, source);
     return true;
 }
 
-alloc_t tm_alloc(shared_t shared, tx_t unused(tx), size_t size, void** unused(target)) {
-    region_t* region = (region_t*) shared;
+static alloc_t tm_alloc_segment(region_t* region, transaction_t* transaction, size_t size, void** target) {
+    if (size > SEGMENT_MAX_SIZE) {
+        return nomem_alloc;
+    }
 
-    uint32_t segment_num = add_segment(region, size);
-    if (segment_num == (uint32_t)-1) {
+    segment_descriptor_t* desc = segment_pool_alloc(region, transaction->ctx, size);
+    if (!desc) {
+        return nomem_alloc;
+    }
+    if (!vector_push_back(transaction->allocs, desc)) {
+        segment_pool_free(region, transaction->ctx, desc);
         return nomem_alloc;
     }
-    *target = build_virtual_address(segment_num, 0);
+    *target = segment_address(region, desc);
     return success_alloc;
 }
 
-bool tm_free(shared_t shared, tx_t unused(tx), void* segment) {
+alloc_t tm_alloc(shared_t shared, tx_t tx, size_t size, void** target) {
     region_t* region = (region_t*) shared;
-    segment_descriptor_t* desc = find_segment(region, segment);
-
-    /* Every _ number of frees, we remove all scheduled to be removed */
-    uint32_t old_threshold = 1024;
+    alloc_t result = tm_alloc_segment(region, (transaction_t*)tx, size, target);
+    trace_call(region, ((transaction_t*)tx)->ctx, TRACE_ALLOC, result == success_alloc ? *target : NULL,
+               size, result, NULL);
+    return result;
+}
 
-    pthread_mutex_lock(&(region->allocs_lock));
-    schedule_to_delete(region, desc);
-    if (region->allocs_frees % old_threshold == 0) 
-        delete_old_segments(region);
-    pthread_mutex_unlock(&(region->allocs_lock));
+bool tm_free(shared_t shared, tx_t tx, void* segment) {
+    region_t* region = (region_t*) shared;
+    segment_descriptor_t* desc = find_allocation(region, segment);
 
+    /* Segment is retired only if tx commits, see tm_commit */
+    if (!tm_segment_found((transaction_t*)tx, desc) ||
+        !vector_push_back(((transaction_t*)tx)->frees, desc)) {
+        if (desc)
+            stats_abort((transaction_t*)tx, TM_ABORT_NOMEM);
+        tm_abort((transaction_t*)tx);
+        trace_call(region, ((transaction_t*)tx)->ctx, TRACE_FREE, segment, 0, false, NULL);
+        return false;
+    }
+    trace_call(region, ((transaction_t*)tx)->ctx, TRACE_FREE, segment, 0, true, NULL);
     return true;
 }
+
+bool tm_atomic(shared_t shared, bool is_ro, tm_body_t body, void* arg) {
+    region_t* region = (region_t*) shared;
+    thread_ctx_t* ctx = thread_ctx_get(region);
+    if (unlikely(!ctx))
+        return false;
+    for (size_t attempt = 0;; ++attempt) {
+        /* Policy can change between attempts, each is counted under its own */
+        tm_cm_t cm = atomic_load_explicit(&(region->cm), memory_order_relaxed);
+        cm_on_begin(ctx, cm);
+        tx_t tx = tm_begin(shared, is_ro);
+        if (unlikely(tx == invalid_tx))
+            return false;
+        if (body(shared, tx, arg)) {
+            if (tm_end(shared, tx)) {
+                cm_on_commit(ctx, cm);
+                return true;
+            }
+        }
+        else if (((transaction_t*)tx)->running) {
+            /* Body gave up on its own, no call released the transaction */
+            stats_abort((transaction_t*)tx, TM_ABORT_BODY);
+            tm_abort((transaction_t*)tx);
+            trace_call(region, ctx, TRACE_END, NULL, 0, false, NULL);
+        }
+        cm_on_abort(ctx, cm, attempt);
+    }
+}
+
+void tm_set_cm(shared_t shared, tm_cm_t cm) {
+    region_t* region = (region_t*) shared;
+    if (cm < TM_CM_COUNT)
+        atomic_store_explicit(&(region->cm), cm, memory_order_relaxed);
+}
+
+void tm_cm_stats(shared_t shared, tm_cm_stats_t* stats) {
+    region_t* region = (region_t*) shared;
+    memset(stats, 0, sizeof(*stats));
+    /* Contexts are only prepended, so the list can be walked concurrently */
+    for (thread_ctx_t* ctx = atomic_load(&(region->threads)); ctx; ctx = ctx->next) {
+        for (size_t i = 0; i < TM_CM_COUNT; ++i) {
+            stats->commits[i] += atomic_load_explicit(&(ctx->cm_commits[i]), memory_order_relaxed);
+            stats->aborts[i] += atomic_load_explicit(&(ctx->cm_aborts[i]), memory_order_relaxed);
+        }
+    }
+}
+
+void tm_mv_stats(shared_t shared, tm_mv_stats_t* stats) {
+    mv_stats((region_t*) shared, stats);
+}
+
+void tm_stats(shared_t shared, tm_stats_t* stats) {
+    stats_collect((region_t*) shared, stats);
+}
+
+void tm_stats_reset(shared_t shared) {
+    stats_reset((region_t*) shared);
+}
+
+size_t tm_hot_fields(shared_t shared, tm_hot_field_t* fields, size_t k) {
+    return profile_top((region_t*) shared, fields, k);
+}
@@ -0,0 +1,139 @@
+// Requested feature: ftruncate, mmap
+#define _POSIX_C_SOURCE   200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "trace.h"
+#include "stats.h"
+#include "addressing.h"
+
+int trace_init(region_t* region, const char* prefix) {
+    region->trace_prefix = NULL;
+    if (!prefix || !*prefix)
+        return INIT_SUCCESS;
+    region->trace_prefix = strdup(prefix);
+    if (!region->trace_prefix)
+        return INIT_FAIL;
+    region->trace_start = stats_now();
+    return INIT_SUCCESS;
+}
+
+void trace_destroy(region_t* region) {
+    free(region->trace_prefix);
+}
+
+/*
+ * Map chunk of the file at given offset, growing the file to hold it
+ */
+static bool trace_map(trace_writer_t* writer, uint64_t offset) {
+    if (ftruncate(writer->fd, (off_t)(offset + TRACE_CHUNK)) != 0)
+        return false;
+    void* window = mmap(NULL, TRACE_CHUNK, PROT_READ | PROT_WRITE, MAP_SHARED, writer->fd, (off_t)offset);
+    if (window == MAP_FAILED)
+        return false;
+    writer->window = (char*)window;
+    writer->window_offset = offset;
+    writer->position = 0;
+    return true;
+}
+
+/*
+ * Stop recording, file keeps what was recorded so far
+ */
+static void trace_fail(trace_writer_t* writer) {
+    if (writer->window)
+        munmap(writer->window, TRACE_CHUNK);
+    writer->window = NULL;
+    if (writer->fd >= 0)
+        close(writer->fd);
+    writer->fd = -1;
+}
+
+/*
+ * Create the file of the thread, with its header
+ */
+static trace_writer_t* trace_open(thread_ctx_t* ctx) {
+    region_t* region = ctx->region;
+    trace_writer_t* writer = (trace_writer_t*)malloc(sizeof(trace_writer_t));
+    if (!writer)
+        return NULL;
+    writer->window = NULL;
+    char path[4096];
+    snprintf(path, sizeof(path), "%s.%llu.%zu", region->trace_prefix, (unsigned long long)region->id, ctx->index);
+    writer->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (writer->fd < 0)
+        return writer;
+    if (!trace_map(writer, 0)) {
+        trace_fail(writer);
+        return writer;
+    }
+
+    struct trace_header* header = (struct trace_header*)writer->window;
+    memcpy(header->magic, TRACE_MAGIC, sizeof(header->magic));
+    header->size = region->desc->size;
+    header->align = region->align;
+    header->start = (uint64_t)(uintptr_t)segment_address(region, region->desc);
+    header->thread = ctx->index;
+    header->chunk = TRACE_CHUNK;
+    writer->position = sizeof(struct trace_header);
+    return writer;
+}
+
+/*
+ * Finish the file of the thread, cut to what was recorded
+ */
+void trace_ctx_close(thread_ctx_t* ctx) {
+    trace_writer_t* writer = ctx->trace;
+    if (!writer)
+        return;
+    if (writer->fd >= 0) {
+        uint64_t length = writer->window_offset + writer->position;
+        munmap(writer->window, TRACE_CHUNK);
+        if (ftruncate(writer->fd, (off_t)length) != 0)
+            perror("trace");
+        close(writer->fd);
+    }
+    free(writer);
+    ctx->trace = NULL;
+}
+
+void trace_record(thread_ctx_t* ctx, enum trace_op op, const void* address, size_t size, int result, const void* value) {
+    if (!ctx->trace) {
+        ctx->trace = trace_open(ctx);
+        if (!ctx->trace)
+            return;
+    }
+    trace_writer_t* writer = ctx->trace;
+    if (writer->fd < 0)
+        return;
+
+    size_t length = trace_record_size(op, size);
+    if (writer->position + length > TRACE_CHUNK) {
+        /* Readers skip the rest of the chunk, marked if a record fits */
+        if (writer->position + sizeof(trace_record_t) <= TRACE_CHUNK)
+            ((trace_record_t*)(writer->window + writer->position))->op = TRACE_PAD;
+        uint64_t offset = writer->window_offset + TRACE_CHUNK;
+        munmap(writer->window, TRACE_CHUNK);
+        writer->window = NULL;
+        if (!trace_map(writer, offset)) {
+            trace_fail(writer);
+            return;
+        }
+    }
+
+    trace_record_t* record = (trace_record_t*)(writer->window + writer->position);
+    record->time = stats_now() - ctx->region->trace_start;
+    record->address = (uint64_t)(uintptr_t)address;
+    record->size = (uint32_t)size;
+    record->op = (uint8_t)op;
+    record->result = (uint8_t)result;
+    record->reserved = 0;
+    if (length > sizeof(trace_record_t))
+        memcpy(record + 1, value, size);
+    writer->position += length;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "structs.h"
+#include "thread_ctx.h"
+
+#define TRACE_CHUNK (16u << 20) /* Hyperparameter, bytes of a trace file mapped at once (multiple of pages) */
+#define TRACE_VALUE_MAX 4096    /* Hyperparameter, largest write whose value is recorded */
+#define TRACE_MAGIC "TMTRACE1"
+
+/*
+ * Trace of the tm_* calls of a region (tm_config_t.trace), for replay by
+ * bench/trace_replay.
+ *
+ * Every thread records into its own file, <prefix>.<region id>.<thread
+ * index>, so recording needs no synchronization. The file is written
+ * through a mapped window of TRACE_CHUNK bytes, which moves to the next
+ * chunk when full, and is cut to its length when the region is destroyed.
+ *
+ * File is a trace_header followed by trace_records, in order of calls. A
+ * record of a write with at most TRACE_VALUE_MAX bytes is followed by the
+ * written value, padded to 8 bytes. Records never cross chunks: the rest
+ * of a chunk is skipped if shorter than a record or if it starts with
+ * TRACE_PAD. Record with op 0 ends the file (in a file of a process that
+ * exited without destroying the region).
+ */
+
+enum trace_op {
+    TRACE_END_OF_FILE = 0,
+    TRACE_BEGIN,                /* result: whether read-only */
+    TRACE_READ,                 /* result: whether it succeeded */
+    TRACE_WRITE,                /* result: whether it succeeded */
+    TRACE_ALLOC,                /* result: alloc_t, address: allocated segment */
+    TRACE_FREE,                 /* result: whether it succeeded */
+    TRACE_END,                  /* result: whether it commited */
+    TRACE_PAD                   /* Rest of the chunk is unused */
+};
+
+struct trace_header {
+    char magic[8];              /* TRACE_MAGIC, without the terminating 0 */
+    uint64_t size;              /* Of the first segment */
+    uint64_t align;
+    uint64_t start;             /* Virtual address of the first segment */
+    uint64_t thread;            /* Index of the thread in the region */
+    uint64_t chunk;             /* TRACE_CHUNK of the recording build */
+};
+
+struct trace_record {
+    uint64_t time;              /* Nanoseconds since the region was created */
+    uint64_t address;           /* Virtual address of the call, 0 for begin and end */
+    uint32_t size;              /* Bytes read, written or allocated */
+    uint8_t op;                 /* One of trace_op */
+    uint8_t result;
+    uint16_t reserved;
+};
+typedef struct trace_record trace_record_t;
+
+/*
+ * Recording state of a thread, in its context
+ */
+struct trace_writer {
+    int fd;                     /* -1 if the file could not be opened, nothing is recorded */
+    char* window;               /* Mapped chunk being written */
+    uint64_t window_offset;     /* Offset of the window in the file */
+    size_t position;            /* Bytes used in the window */
+};
+typedef struct trace_writer trace_writer_t;
+
+int trace_init(region_t* region, const char* prefix);
+void trace_destroy(region_t* region);
+void trace_ctx_close(thread_ctx_t* ctx);
+void trace_record(thread_ctx_t* ctx, enum trace_op op, const void* address, size_t size, int result, const void* value);
+
+/*
+ * Bytes recorded for a write of given size, value included
+ */
+static inline size_t trace_record_size(enum trace_op op, size_t size) {
+    if (op != TRACE_WRITE || size > TRACE_VALUE_MAX)
+        return sizeof(trace_record_t);
+    return sizeof(trace_record_t) + ((size + 7) & ~(size_t)7);
+}
+
+/*
+ * Record a call, if the region is traced
+ */
+static inline void trace_call(region_t* region, thread_ctx_t* ctx, enum trace_op op, const void* address,
+                              size_t size, int result, const void* value) {
+    if (unlikely(region->trace_prefix))
+        trace_record(ctx, op, address, size, result, value);
+}
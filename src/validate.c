@@ -0,0 +1,92 @@
+#include "validate.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+const char* const validate_isa_names[VALIDATE_ISA_COUNT] = {
+    "scalar", "avx2", "avx512"
+};
+
+static size_t validate_scalar(const read_entry_t* entries, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (atomic_load_explicit(entries[i].lock, memory_order_acquire) != vlock_free_word(entries[i].version))
+            return i;
+    }
+    return n;
+}
+
+#if defined(__x86_64__)
+
+/*
+ * Entries are (lock, version) pairs, unpacking two vectors of them gives
+ * vector of locks and vector of versions in the same (interleaved) order.
+ * Lock words are gathered with the lock pointers as absolute addresses, each
+ * element is one aligned 64-bit load, and x86 keeps loads in order.
+ * First block with a mismatch is left to the scalar kernel.
+ */
+__attribute__((target("avx2")))
+static size_t validate_avx2(const read_entry_t* entries, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i low = _mm256_loadu_si256((const __m256i*)&(entries[i]));
+        __m256i high = _mm256_loadu_si256((const __m256i*)&(entries[i + 2]));
+        __m256i locks = _mm256_unpacklo_epi64(low, high);
+        __m256i versions = _mm256_unpackhi_epi64(low, high);
+        __m256i words = _mm256_i64gather_epi64((const long long*)0, locks, 1);
+        __m256i equal = _mm256_cmpeq_epi64(words, _mm256_slli_epi64(versions, 1));
+        if (_mm256_movemask_epi8(equal) != -1)
+            break;
+    }
+    return i + validate_scalar(&(entries[i]), n - i);
+}
+
+__attribute__((target("avx512f")))
+static size_t validate_avx512(const read_entry_t* entries, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i low = _mm512_loadu_si512((const void*)&(entries[i]));
+        __m512i high = _mm512_loadu_si512((const void*)&(entries[i + 4]));
+        __m512i locks = _mm512_unpacklo_epi64(low, high);
+        __m512i versions = _mm512_unpackhi_epi64(low, high);
+        __m512i words = _mm512_i64gather_epi64(locks, (const void*)0, 1);
+        if (_mm512_cmpneq_epi64_mask(words, _mm512_slli_epi64(versions, 1)))
+            break;
+    }
+    return i + validate_avx2(&(entries[i]), n - i);
+}
+
+#endif
+
+validate_kernel_t validate_kernel = validate_scalar;
+
+validate_kernel_t validate_kernel_of(validate_isa_t isa) {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    switch (isa) {
+    case VALIDATE_AVX2:
+        return __builtin_cpu_supports("avx2") ? validate_avx2 : NULL;
+    case VALIDATE_AVX512:
+        /* Tail of AVX-512 kernel runs AVX2 kernel */
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") ? validate_avx512 : NULL;
+    default:
+        return validate_scalar;
+    }
+#else
+    return isa == VALIDATE_SCALAR ? validate_scalar : NULL;
+#endif
+}
+
+/*
+ * Choose the kernel once, before any transaction can run
+ */
+__attribute__((constructor))
+static void validate_init(void) {
+    for (int isa = VALIDATE_ISA_COUNT - 1; isa >= 0; --isa) {
+        validate_kernel_t kernel = validate_kernel_of((validate_isa_t)isa);
+        if (kernel) {
+            validate_kernel = kernel;
+            return;
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "read_set.h"
+
+/*
+ * Kernels of read set validation. A kernel checks that lock of every entry
+ * holds the free word of its version, and returns the number of leading
+ * entries which do (n if all do). Entries it stops at may still be valid,
+ * they are locked by the transaction itself or were locked only briefly, so
+ * the caller checks them one by one, see tl2_validate.
+ *
+ * The fastest kernel the CPU supports is chosen when the library is loaded.
+ */
+typedef size_t (*validate_kernel_t)(const read_entry_t* entries, size_t n);
+
+typedef enum validate_isa {
+    VALIDATE_SCALAR = 0,
+    VALIDATE_AVX2,              /* 4 entries per step, gather of lock words */
+    VALIDATE_AVX512,            /* 8 entries per step */
+    VALIDATE_ISA_COUNT
+} validate_isa_t;
+
+extern const char* const validate_isa_names[VALIDATE_ISA_COUNT];
+extern validate_kernel_t validate_kernel;
+
+/*
+ * Kernel of given instruction set, NULL if the CPU does not support it
+ */
+validate_kernel_t validate_kernel_of(validate_isa_t isa);
+
+static inline size_t validate_entries(const read_entry_t* entries, size_t n) {
+    return validate_kernel(entries, n);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "macros.h"
+
+/*
+ * Versioned lock of one field. While free the word holds the version of the
+ * field shifted by one, while locked it holds the address of the context of
+ * the owning thread with the lowest bit set. Version of a locked field is
+ * remembered by its owner.
+ */
+typedef _Atomic(uint64_t) vlock_t;
+
+#define VLOCK_LOCKED 1
+
+static inline bool vlock_is_locked(uint64_t word) {
+    return word & VLOCK_LOCKED;
+}
+
+static inline uint64_t vlock_version(uint64_t word) {
+    return word >> 1;
+}
+
+/* Word of a free lock with given version */
+static inline uint64_t vlock_free_word(uint64_t version) {
+    return version << 1;
+}
+
+/* Word of a lock held by given owner */
+static inline uint64_t vlock_owned_word(const void* owner) {
+    return (uint64_t)(uintptr_t)owner | VLOCK_LOCKED;
+}
+
+/*
+ * Sample the lock before reading the field it guards
+ */
+static inline uint64_t vlock_sample(vlock_t* lock) {
+    return atomic_load_explicit(lock, memory_order_acquire);
+}
+
+/*
+ * Sample the lock again after reading the field, if the word did not
+ * change (and was free) the read value is consistent with it
+ */
+static inline uint64_t vlock_resample(vlock_t* lock) {
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(lock, memory_order_relaxed);
+}
+
+/*
+ * Try to lock for given owner, expected is the free word sampled before.
+ * Writes to the field done after locking are not visible before the lock.
+ */
+static inline bool vlock_try_lock(vlock_t* lock, uint64_t expected, const void* owner) {
+    if (!atomic_compare_exchange_strong_explicit(lock, &expected, vlock_owned_word(owner),
+            memory_order_acquire, memory_order_relaxed))
+        return false;
+    atomic_thread_fence(memory_order_release);
+    return true;
+}
+
+/*
+ * Unlock publishing given version (new one at commit, old one on abort)
+ */
+static inline void vlock_unlock(vlock_t* lock, uint64_t version) {
+    atomic_store_explicit(lock, vlock_free_word(version), memory_order_release);
+}
+
+/*
+ * Spin on a lock held by another owner, doubling pauses between samples,
+ * for at most about limit pauses. True if the lock got free, its word is
+ * stored to word.
+ */
+static inline bool vlock_wait(vlock_t* lock, uint64_t* word, uint64_t limit) {
+    for (uint64_t pause = 1, spent = 0; spent < limit; spent += pause, pause <<= 1) {
+        for (uint64_t i = 0; i < pause; ++i)
+            cpu_relax();
+        *word = vlock_sample(lock);
+        if (!vlock_is_locked(*word))
+            return true;
+    }
+    return false;
+}
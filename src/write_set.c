@@ -0,0 +1,187 @@
+#include <string.h>
+
+#include "write_set.h"
+#include "macros.h"
+
+/* Write sets up to this size are sorted by insertion sort, hyperparameter */
+#define WRITE_SET_INSERTION_SORT 16
+
+/* Table has twice as many slots as there is room for entries, so it is
+   at most half full */
+
+static inline uint64_t write_set_hash(const void* target) {
+    /* Fields are at least word aligned, so low bits carry no information */
+    return ((uint64_t)target >> 3) * 0x9E3779B97F4A7C15ull;
+}
+
+static inline uint64_t write_set_bloom_bits(uint64_t hash) {
+    /* Two bits of the filter, taken from the top of the hash */
+    return (1ull << (hash >> 58)) | (1ull << ((hash >> 52) & 63));
+}
+
+write_set_t* write_set_init(size_t n) {
+    write_set_t* ws = (write_set_t*)malloc(sizeof(write_set_t));
+    if (!ws)
+        return NULL;
+    ws->entries = (write_entry_t*)malloc(n * sizeof(write_entry_t));
+    if (!ws->entries) {
+        free(ws);
+        return NULL;
+    }
+    ws->table = (uint32_t*)calloc(2 * n, sizeof(uint32_t));
+    if (!ws->table) {
+        free(ws->entries);
+        free(ws);
+        return NULL;
+    }
+    ws->size = 0;
+    ws->size_max = n;
+    ws->table_mask = 2 * n - 1;
+    ws->bloom = 0;
+    return ws;
+}
+
+void write_set_destroy(write_set_t* ws) {
+    free(ws->entries);
+    free(ws->table);
+    free(ws);
+}
+
+/*
+ * Remove all entries, keeping the capacity. Only slots of the entries are
+ * cleared, in reverse order of insertion, so that the probe sequence of
+ * every cleared entry is still intact when it is looked for.
+ */
+void write_set_clear(write_set_t* ws) {
+    for (size_t i = ws->size - 1; i != (size_t)-1; i--) {
+        size_t slot = write_set_hash(ws->entries[i].target) & ws->table_mask;
+        while (ws->table[slot] != i + 1)
+            slot = (slot + 1) & ws->table_mask;
+        ws->table[slot] = 0;
+    }
+    ws->size = 0;
+    ws->bloom = 0;
+}
+
+write_entry_t* write_set_find(const write_set_t* ws, const void* target) {
+    uint64_t hash = write_set_hash(target);
+    uint64_t bits = write_set_bloom_bits(hash);
+    if (likely((ws->bloom & bits) != bits))
+        return NULL; /* Surely not in the set */
+
+    for (size_t slot = hash & ws->table_mask; ws->table[slot] != 0; 
+         slot = (slot + 1) & ws->table_mask) {
+        write_entry_t* entry = &(ws->entries[ws->table[slot] - 1]);
+        if (entry->target == target)
+            return entry;
+    }
+    return NULL; /* Element not in the set */
+}
+
+/*
+ * Place entry with given index in the table, assumes that it is not there
+ */
+static void write_set_place(write_set_t* ws, size_t index) {
+    size_t slot = write_set_hash(ws->entries[index].target) & ws->table_mask;
+    while (ws->table[slot] != 0)
+        slot = (slot + 1) & ws->table_mask;
+    ws->table[slot] = index + 1;
+}
+
+static bool write_set_grow(write_set_t* ws) {
+    size_t size_max = 2 * ws->size_max;
+    write_entry_t* entries = (write_entry_t*)realloc(ws->entries, size_max * sizeof(write_entry_t));
+    if (!entries)
+        return false;
+    ws->entries = entries;
+
+    uint32_t* table = (uint32_t*)calloc(2 * size_max, sizeof(uint32_t));
+    if (!table)
+        return false; /* Old table is still consistent with the entries */
+    free(ws->table);
+    ws->table = table;
+    ws->table_mask = 2 * size_max - 1;
+    ws->size_max = size_max;
+    for (size_t i = 0; i < ws->size; ++i)
+        write_set_place(ws, i);
+    return true;
+}
+
+/*
+ * Find entry for given target, or add new one (with unset value) if target
+ * was not written yet. Sets 'inserted' accordingly.
+ *
+ * NULL if could not allocate
+ */
+write_entry_t* write_set_insert(write_set_t* ws, void* target, bool* inserted) {
+    write_entry_t* entry = write_set_find(ws, target);
+    if (entry) {
+        *inserted = false;
+        return entry;
+    }
+    if (ws->size == ws->size_max && !write_set_grow(ws))
+        return NULL;
+
+    entry = &(ws->entries[ws->size]);
+    entry->target = target;
+    entry->value = NULL;
+    entry->node = NULL;
+    write_set_place(ws, ws->size);
+    ws->size++;
+    ws->bloom |= write_set_bloom_bits(write_set_hash(target));
+    *inserted = true;
+    return entry;
+}
+
+/*
+ * Remove the last inserted entry, whose value could not be set. Its slot is
+ * cleared too, no entry was placed after it so no probe sequence breaks.
+ * Bloom filter keeps its bits, which only costs a probe.
+ */
+void write_set_drop_last(write_set_t* ws) {
+    size_t i = ws->size - 1;
+    size_t slot = write_set_hash(ws->entries[i].target) & ws->table_mask;
+    while (ws->table[slot] != i + 1)
+        slot = (slot + 1) & ws->table_mask;
+    ws->table[slot] = 0;
+    ws->size = i;
+}
+
+static int write_set_compare(const void* a, const void* b) {
+    uintptr_t x = (uintptr_t)((const write_entry_t*)a)->target;
+    uintptr_t y = (uintptr_t)((const write_entry_t*)b)->target;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Sort entries by target address, which orders them by segment number and
+ * then by field (see addressing.h). The table is rebuilt for the new order.
+ */
+void write_set_sort(write_set_t* ws) {
+    if (ws->size < 2)
+        return;
+    for (size_t i = 0; i < ws->size; ++i) {
+        /* Search does not stop at empty slots, so any order of clearing works */
+        size_t slot = write_set_hash(ws->entries[i].target) & ws->table_mask;
+        while (ws->table[slot] != i + 1)
+            slot = (slot + 1) & ws->table_mask;
+        ws->table[slot] = 0;
+    }
+
+    if (ws->size <= WRITE_SET_INSERTION_SORT) {
+        /* Typical transaction writes a few fields */
+        for (size_t i = 1; i < ws->size; ++i) {
+            write_entry_t entry = ws->entries[i];
+            size_t j = i;
+            for (; j > 0 && write_set_compare(&(ws->entries[j - 1]), &entry) > 0; --j)
+                ws->entries[j] = ws->entries[j - 1];
+            ws->entries[j] = entry;
+        }
+    }
+    else {
+        qsort(ws->entries, ws->size, sizeof(write_entry_t), write_set_compare);
+    }
+
+    for (size_t i = 0; i < ws->size; ++i)
+        write_set_place(ws, i);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "vlock.h"
+
+#define WRITE_SET_DEFAULT_SIZE 8 /* Hyperparameter, must be a power of two */
+
+/* One buffered write of a transaction */
+struct write_entry {
+    void* target;               /* Virtual address of the written field */
+    void* value;                /* Buffer with the value to be written */
+    void* data;                 /* Physical address of the target field */
+    vlock_t* lock;              /* Versioned lock of the target field */
+    uint64_t version;           /* Version of the field when it was locked */
+    struct mv_node* node;       /* Node for the overwritten value, see mvcc.h */
+    _Atomic(struct mv_node*)* chain; /* Chain of old values of the field */
+};
+typedef struct write_entry write_entry_t;
+
+/*
+ * Write set of a transaction. Entries are kept densely in insertion order
+ * (so commit can iterate them linearly), and are indexed by an open addressing
+ * hash table keyed by target address. A one word Bloom filter sits in front
+ * of the table, so most lookups of fields not written are answered without
+ * probing it.
+ */
+struct write_set {
+    write_entry_t* entries;     /* Dense array of entries */
+    size_t size, size_max;
+    uint32_t* table;            /* Index of entry + 1, 0 for empty slot */
+    size_t table_mask;          /* Table size - 1, table size is a power of two */
+    uint64_t bloom;             /* Bloom filter of targets in the set */
+};
+typedef struct write_set write_set_t;
+
+write_set_t* write_set_init(size_t n);
+void write_set_destroy(write_set_t* ws);
+void write_set_clear(write_set_t* ws);
+write_entry_t* write_set_find(const write_set_t* ws, const void* target);
+write_entry_t* write_set_insert(write_set_t* ws, void* target, bool* inserted);
+void write_set_drop_last(write_set_t* ws);
+void write_set_sort(write_set_t* ws);